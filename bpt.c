@@ -0,0 +1,466 @@
+//////////////////////////////////////////////////////////////////////////////
+// bpt.c                                                                    //
+//////////////////////////////////////////////////////////////////////////////
+// bpt.c contains implementations of the functions declared in bpt.h.
+#include "bpt.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+
+#if !defined(BPT_SCALAR) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#define BPT_ERROR "\033[31;1mError: \033[0m"
+
+#ifdef ALLOC_TRACK
+extern unsigned int NUM_NODES; // (see rbt.c)
+#endif // ALLOC_TRACK
+
+//////////////////////////////////////////////////////////////////////////////
+// Index Nodes                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Returns a new, empty index node.
+// Raises SIGABRT if it cannot be allocated.
+BPT BPT_node_new(bool leaf) {
+    BPT node = aligned_alloc(BPT_CACHE_LINE, sizeof(struct BPT_node));
+    if (node == NULL) {
+        printf(BPT_ERROR "cannot allocate a BPT index node\n");
+        raise(SIGABRT);
+        return NULL;
+    }
+    for (int i = 0; i < BPT_ORDER; i++) {
+        node->keys[i] = BPT_EMPTY;
+        node->children[i] = NULL;
+    }
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+// helper: Returns the position of the first key in `node` that is at least
+// `capacity` (`node->count` if there is none).
+// Keys are sorted, so this is the number of keys that are less than
+// `capacity`. Unused keys are BPT_EMPTY, so every key is compared without
+// branching. With AVX2 or SSE2 (when compiled with support for them), the
+// whole first cache line is compared at once: the comparison results are
+// packed into one bit per key, and since the keys less than `capacity` form a
+// prefix, the position of the first 0 bit is the result.
+// Compile with "-D BPT_SCALAR" to compare keys one at a time instead.
+//
+// NOTE: SIMD comparisons are signed, so both sides are biased by 2^31 to
+// compare them as unsigned.
+unsigned int BPT_lower_bound(BPT node, unsigned int capacity) {
+    #if !defined(BPT_SCALAR) && defined(__AVX2__) && BPT_ORDER == 16
+    __m256i bias = _mm256_set1_epi32((int)0x80000000);
+    __m256i c = _mm256_xor_si256(_mm256_set1_epi32((int)capacity), bias);
+    __m256i lo = _mm256_load_si256((__m256i *)&node->keys[0]);
+    __m256i hi = _mm256_load_si256((__m256i *)&node->keys[8]);
+    lo = _mm256_cmpgt_epi32(c, _mm256_xor_si256(lo, bias));
+    hi = _mm256_cmpgt_epi32(c, _mm256_xor_si256(hi, bias));
+    unsigned int less = _mm256_movemask_ps(_mm256_castsi256_ps(lo)) |
+                        _mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8;
+    return __builtin_ctz(~less);
+    #elif !defined(BPT_SCALAR) && defined(__SSE2__) && BPT_ORDER == 16
+    __m128i bias = _mm_set1_epi32((int)0x80000000);
+    __m128i c = _mm_xor_si128(_mm_set1_epi32((int)capacity), bias);
+    __m128i less[4];
+    for (int j = 0; j < 4; j++) {
+        __m128i keys = _mm_load_si128((__m128i *)&node->keys[4 * j]);
+        less[j] = _mm_cmpgt_epi32(c, _mm_xor_si128(keys, bias));
+    }
+    // pack the 32-bit results into bytes, then take one bit per byte
+    __m128i packed = _mm_packs_epi16(_mm_packs_epi32(less[0], less[1]),
+                                     _mm_packs_epi32(less[2], less[3]));
+    return __builtin_ctz(~(unsigned int)_mm_movemask_epi8(packed));
+    #else
+    unsigned int i = 0;
+    for (int j = 0; j < BPT_ORDER; j++) {
+        i += node->keys[j] < capacity;
+    }
+    return i;
+    #endif
+}
+
+// helper: Returns the largest key in `node`.
+// Assumes node->count > 0.
+unsigned int BPT_max(BPT node) {
+    return node->keys[node->count - 1];
+}
+
+// helper: Inserts an entry at position `i` of `node`.
+// Assumes node->count < BPT_ORDER.
+void BPT_insert_entry(BPT node, unsigned int i, unsigned int key, void *ptr) {
+    memmove(&node->keys[i + 1], &node->keys[i],
+            (node->count - i) * sizeof(node->keys[0]));
+    memmove(&node->children[i + 1], &node->children[i],
+            (node->count - i) * sizeof(node->children[0]));
+    node->keys[i] = key;
+    node->children[i] = ptr;
+    node->count++;
+}
+
+// helper: Deletes the entry at position `i` of `node`.
+void BPT_delete_entry(BPT node, unsigned int i) {
+    node->count--;
+    memmove(&node->keys[i], &node->keys[i + 1],
+            (node->count - i) * sizeof(node->keys[0]));
+    memmove(&node->children[i], &node->children[i + 1],
+            (node->count - i) * sizeof(node->children[0]));
+    node->keys[node->count] = BPT_EMPTY;
+    node->children[node->count] = NULL;
+}
+
+// helper: Moves the entries of `node` from position `i` onwards to the end
+// of `dest`.
+// Assumes there is room for them in `dest`.
+void BPT_move_entries(BPT dest, BPT node, unsigned int i) {
+    unsigned int n = node->count - i;
+    memcpy(&dest->keys[dest->count], &node->keys[i], n * sizeof(node->keys[0]));
+    memcpy(&dest->children[dest->count], &node->children[i],
+            n * sizeof(node->children[0]));
+    dest->count += n;
+    for (unsigned int j = i; j < node->count; j++) {
+        node->keys[j] = BPT_EMPTY;
+        node->children[j] = NULL;
+    }
+    node->count = i;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BPT Insertion                                                            //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Inserts an entry at position `i` of `node`, splitting `node` if it
+// is full. Returns the new right half of `node` if it was split. Otherwise,
+// returns NULL.
+BPT BPT_insert_or_split(BPT node, unsigned int i, unsigned int key, void *ptr) {
+    if (node->count < BPT_ORDER) {
+        BPT_insert_entry(node, i, key, ptr);
+        return NULL;
+    }
+    BPT sibling = BPT_node_new(node->leaf);
+    BPT_move_entries(sibling, node, BPT_ORDER / 2);
+    if (i <= BPT_ORDER / 2) {
+        BPT_insert_entry(node, i, key, ptr);
+    } else {
+        BPT_insert_entry(sibling, i - BPT_ORDER / 2, key, ptr);
+    }
+    return sibling;
+}
+
+// helper: recursive part of BPT_add.
+// Returns the new right sibling of `root` if it was split. Otherwise, returns
+// NULL.
+BPT BPT_add_inner(BPT root, RBT node, unsigned int capacity) {
+    unsigned int i = BPT_lower_bound(root, capacity);
+    if (root->leaf) {
+        if (i < root->count && root->keys[i] == capacity) {
+            // add the new node to the linked-list
+            node->next = root->heads[i];
+            root->heads[i] = node;
+            return NULL;
+        }
+        return BPT_insert_or_split(root, i, capacity, node);
+    }
+    if (i == root->count) { // capacity is larger than every key
+        i--;
+    }
+    BPT child = root->children[i];
+    BPT sibling = BPT_add_inner(child, node, capacity);
+    root->keys[i] = BPT_max(child);
+    if (sibling == NULL) {
+        return NULL;
+    }
+    return BPT_insert_or_split(root, i + 1, BPT_max(sibling), sibling);
+}
+
+BPT BPT_add(BPT root, RBT node, unsigned int capacity) {
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    if (node == NULL) {
+        return root;
+    }
+    node->capacity = capacity;
+    node->prev_dist = 0;
+    node->left = NULL;
+    node->right = NULL;
+    node->next = NULL;
+    node->in_use = false;
+    node->color = BLACK;
+
+    if (root == NULL) {
+        root = BPT_node_new(true);
+    }
+    BPT sibling = BPT_add_inner(root, node, capacity);
+    if (sibling != NULL) { // grow a new root
+        BPT new_root = BPT_node_new(false);
+        BPT_insert_entry(new_root, 0, BPT_max(root), root);
+        BPT_insert_entry(new_root, 1, BPT_max(sibling), sibling);
+        root = new_root;
+    }
+    #ifdef ALLOC_TRACK
+    NUM_NODES++;
+    #endif // ALLOC_TRACK
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    return root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BPT Removal                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Restores the minimum number of entries of `root->children[i]` by
+// moving an entry from one of its siblings or merging it with one.
+void BPT_fix_underflow(BPT root, unsigned int i) {
+    BPT child = root->children[i];
+    BPT left = i > 0 ? root->children[i - 1] : NULL;
+    BPT right = i + 1 < root->count ? root->children[i + 1] : NULL;
+    if (left != NULL && left->count > BPT_MIN) {
+        // move the largest entry of `left` to the front of `child`
+        unsigned int last = left->count - 1;
+        BPT_insert_entry(child, 0, left->keys[last], left->children[last]);
+        BPT_delete_entry(left, last);
+        root->keys[i - 1] = BPT_max(left);
+    } else if (right != NULL && right->count > BPT_MIN) {
+        // move the smallest entry of `right` to the end of `child`
+        BPT_insert_entry(child, child->count, right->keys[0], right->children[0]);
+        BPT_delete_entry(right, 0);
+        root->keys[i] = BPT_max(child);
+    } else if (left != NULL) {
+        // merge `child` into `left`
+        BPT_move_entries(left, child, 0);
+        root->keys[i - 1] = BPT_max(left);
+        BPT_delete_entry(root, i);
+        free(child);
+    } else if (right != NULL) {
+        // merge `right` into `child`
+        BPT_move_entries(child, right, 0);
+        root->keys[i] = BPT_max(child);
+        BPT_delete_entry(root, i + 1);
+        free(right);
+    }
+}
+
+// helper: recursive part of BPT_remove_at_least and BPT_remove_node.
+// Removes `node` (or, if `node` is NULL, any block with the smallest capacity
+// that is at least `capacity`) from `root` and stores it in `removed`.
+// `root` may be left with fewer than BPT_MIN entries.
+void BPT_remove_inner(BPT root, RBT node, unsigned int capacity, RBT *removed) {
+    unsigned int i = BPT_lower_bound(root, capacity);
+    if (i == root->count) { // no block is large enough
+        *removed = NULL;
+        return;
+    }
+    if (!root->leaf) {
+        BPT_remove_inner(root->children[i], node, capacity, removed);
+        if (*removed == NULL) {
+            return;
+        }
+        BPT child = root->children[i];
+        if (child->count > 0) {
+            root->keys[i] = BPT_max(child);
+        }
+        if (child->count < BPT_MIN) {
+            BPT_fix_underflow(root, i);
+        }
+        return;
+    }
+
+    RBT head = root->heads[i];
+    if (node == NULL || node == head) { // remove the head of the list
+        *removed = head;
+        root->heads[i] = head->next;
+    } else { // `node` can only be in the rest of the list
+        if (root->keys[i] != capacity) {
+            *removed = NULL;
+            return;
+        }
+        RBT prev = head;
+        while (prev->next != NULL && prev->next != node) {
+            prev = prev->next;
+        }
+        if (prev->next == NULL) {
+            *removed = NULL;
+            return;
+        }
+        *removed = node;
+        prev->next = node->next;
+    }
+    (*removed)->next = NULL;
+    if (root->heads[i] == NULL) { // no blocks with this capacity remain
+        BPT_delete_entry(root, i);
+    }
+}
+
+// helper: Shrinks the root of a BPT after a removal (if necessary) and
+// returns the new root.
+BPT BPT_shrink_root(BPT root) {
+    if (root->count == 0) { // the tree is empty
+        free(root);
+        return NULL;
+    }
+    if (!root->leaf && root->count == 1) {
+        BPT child = root->children[0];
+        free(root);
+        return child;
+    }
+    return root;
+}
+
+BPT BPT_remove_at_least(BPT root, unsigned int capacity, RBT *removed) {
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    if (removed == NULL) {
+        return root;
+    }
+    if (root == NULL) {
+        *removed = NULL;
+        return root;
+    }
+    BPT_remove_inner(root, NULL, capacity, removed);
+    if (*removed != NULL) {
+        root = BPT_shrink_root(root);
+    }
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    return root;
+}
+
+BPT BPT_remove_node(BPT root, RBT node, RBT *removed) {
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    if (removed == NULL) {
+        return root;
+    }
+    if (root == NULL || node == NULL) {
+        *removed = NULL;
+        return root;
+    }
+    BPT_remove_inner(root, node, node->capacity, removed);
+    if (*removed != NULL) {
+        root = BPT_shrink_root(root);
+    }
+    #ifdef REP_OK
+    BPT_rep_ok(root);
+    #endif
+    return root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BPT Height and rep_ok                                                    //
+//////////////////////////////////////////////////////////////////////////////
+int BPT_height(BPT root) {
+    int height = 0;
+    while (root != NULL && !root->leaf) {
+        root = root->children[0];
+        height++;
+    }
+    return height;
+}
+
+// helper: recursive part of BPT_rep_ok. `depth` is the depth of `root` and
+// `height` is the depth of every leaf.
+void BPT_rep_ok_inner(BPT root, bool is_root, int depth, int height) {
+    if (root->count > BPT_ORDER || (!is_root && root->count < BPT_MIN) ||
+            (is_root && !root->leaf && root->count < 2)) {
+        printf(BPT_ERROR "index node has %d entries\n", root->count);
+        raise(SIGABRT);
+    }
+    if (root->leaf != (depth == height)) {
+        printf(BPT_ERROR "leaves should all be at depth %d\n", height);
+        raise(SIGABRT);
+    }
+    for (int i = 0; i < BPT_ORDER; i++) {
+        if (i >= root->count) {
+            if (root->keys[i] != BPT_EMPTY || root->children[i] != NULL) {
+                printf(BPT_ERROR "unused entries should be empty\n");
+                raise(SIGABRT);
+            }
+            continue;
+        }
+        if (i > 0 && root->keys[i - 1] >= root->keys[i]) {
+            printf(BPT_ERROR "keys should be sorted and distinct\n");
+            raise(SIGABRT);
+        }
+        if (root->leaf) {
+            if (root->heads[i] == NULL) {
+                printf(BPT_ERROR "leaf entries should not be empty\n");
+                raise(SIGABRT);
+            }
+            for (RBT node = root->heads[i]; node != NULL; node = node->next) {
+                if (node->capacity != root->keys[i]) {
+                    printf(BPT_ERROR "block of capacity %u in list of %u\n",
+                            node->capacity, root->keys[i]);
+                    raise(SIGABRT);
+                }
+            }
+            continue;
+        }
+        BPT child = root->children[i];
+        BPT_rep_ok_inner(child, false, depth + 1, height);
+        if (root->keys[i] != BPT_max(child)) {
+            printf(BPT_ERROR "key %u should be the largest key of its child (%u)\n",
+                    root->keys[i], BPT_max(child));
+            raise(SIGABRT);
+        }
+    }
+}
+
+BPT BPT_rep_ok(BPT root) {
+    if (root != NULL) {
+        BPT_rep_ok_inner(root, true, 0, BPT_height(root));
+    }
+    return root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BPT Freeing                                                              //
+//////////////////////////////////////////////////////////////////////////////
+void BPT_destroy(BPT root, void (*dealloc)(void *context, RBT node),
+        void *context) {
+    if (root == NULL) {
+        return;
+    }
+    for (int i = 0; i < root->count; i++) {
+        if (!root->leaf) {
+            BPT_destroy(root->children[i], dealloc, context);
+            continue;
+        }
+        if (dealloc == NULL) { // forget the blocks (see RBT_forget)
+            #ifdef ALLOC_TRACK
+            for (RBT head = root->heads[i]; head != NULL; head = head->next) {
+                NUM_NODES--;
+            }
+            #endif // ALLOC_TRACK
+            continue;
+        }
+        RBT head = root->heads[i];
+        while (head != NULL) {
+            RBT next = head->next;
+            dealloc(context, head);
+            #ifdef ALLOC_TRACK
+            NUM_NODES--;
+            #endif // ALLOC_TRACK
+            head = next;
+        }
+    }
+    free(root);
+}
+
+// helper: BPT_destroy callback that frees blocks with free.
+void BPT_free_block(void *context, RBT node) {
+    (void)context;
+    free(node);
+}
+
+void BPT_free(BPT root) {
+    BPT_destroy(root, &BPT_free_block, NULL);
+}
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////////
+// bpt.h                                                                    //
+//////////////////////////////////////////////////////////////////////////////
+// bpt.h contains declarations of functions for a B+-tree index of free blocks,
+// an alternative to the RBT with the same semantics as RBT_add,
+// RBT_remove_at_least and RBT_remove_node.
+//
+// Blocks are still `struct RBT` nodes, but the tree structure lives in
+// separately allocated, cache-line aligned index nodes holding up to
+// BPT_ORDER capacities each. A search reads one cache line of capacities per
+// level (about log16(n) levels, rather than log2(n) nodes for an RBT) before
+// following a single child pointer. Each capacity in a leaf refers to a
+// linked list (through `next`) of the blocks with that capacity.
+//
+// Conditional Compilation:
+// The ALLOC_TRACK and REP_OK flags (see rbt.h) apply to BPTs as well.
+
+#ifndef BPT_H
+#define BPT_H
+
+#include <stdbool.h>
+
+#include "rbt.h"
+
+#define BPT_ORDER 16               // maximum number of entries in an index node
+#define BPT_MIN   (BPT_ORDER / 2)  // minimum number of entries (except the root)
+#define BPT_EMPTY ((unsigned int)-1) // the key of an unused entry
+
+#define BPT_CACHE_LINE 64 // alignment (in bytes) of index nodes
+
+// B+-tree index node.
+// Entry i of an internal node is the child `children[i]` whose largest
+// capacity is `keys[i]`. Entry i of a leaf is the list of blocks `heads[i]`,
+// all of which have capacity `keys[i]`. Entries are sorted by key, and unused
+// keys are BPT_EMPTY so that searches never need to read `count`.
+typedef struct BPT_node {
+    unsigned int keys[BPT_ORDER]; // first cache line: the keys searched
+    union {
+        struct BPT_node *children[BPT_ORDER]; // (internal nodes)
+        RBT heads[BPT_ORDER];                 // (leaves)
+    };
+    unsigned short count; // number of entries
+    bool leaf;            // whether the node is a leaf
+} __attribute__((aligned(BPT_CACHE_LINE))) *BPT;
+
+// BPT_add inserts a block (pointed to by `node`) into the BPT `root`, with the
+// same semantics as RBT_add. The returned BPT points to the new root. If
+// `root` is NULL, then it is treated as an empty tree. If `node` is NULL, then
+// `root` is returned.
+// Raises SIGABRT if memory for an index node cannot be allocated.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = BPT_add(tree, ...);
+BPT BPT_add(BPT root, RBT node, unsigned int capacity);
+
+// BPT_remove_at_least removes a block with the smallest capacity that is at
+// least that requested, with the same semantics as RBT_remove_at_least.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = BPT_remove_at_least(tree, ..., ...);
+BPT BPT_remove_at_least(BPT root, unsigned int capacity, RBT *removed);
+
+// BPT_remove_node removes the given block, with the same semantics as
+// RBT_remove_node.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = BPT_remove_node(tree, ..., ...);
+BPT BPT_remove_node(BPT root, RBT node, RBT *removed);
+
+// BPT_height returns the number of levels of index nodes below the root (0
+// for a BPT consisting of a single leaf or an empty BPT).
+int BPT_height(BPT root);
+
+// BPT_rep_ok checks the representation invariant for BPTs:
+//   + Every leaf is at the same depth.
+//   + Every node other than the root has at least BPT_MIN entries.
+//   + Keys are sorted and unused keys are BPT_EMPTY.
+//   + The key of each internal entry is the largest key of its child.
+//   + Every block in a leaf's list has the capacity of its key.
+// If the invariant is violated, raises SIGABRT. Otherwise, returns the
+// original tree (unchanged).
+BPT BPT_rep_ok(BPT root);
+
+// BPT_destroy frees every index node of the BPT and passes every block to
+// `dealloc` along with `context` (see RBT_destroy). If `dealloc` is NULL, only
+// the index nodes are freed.
+void BPT_destroy(BPT root, void (*dealloc)(void *context, RBT node),
+        void *context);
+
+// BPT_free frees every index node and every block of the BPT. Blocks must have
+// been allocated with standard library allocators (see RBT_free).
+void BPT_free(BPT root);
+
+#endif /* BPT_H */
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
@@ -28,6 +29,26 @@
 unsigned int NUM_NODES; // Current number of allocated nodes.
 #endif // ALLOC_TRACK
 
+// RBT_USDT places static probes (see rbt.h). The recursive helpers count the
+// levels they descend in RBT_probe_depth, and the depth at which a node is
+// added or removed is saved in RBT_probe_found for the return probes.
+#ifdef RBT_USDT
+#include <sys/sdt.h>
+static __thread unsigned int RBT_probe_depth; // depth of the current subtree
+static __thread unsigned int RBT_probe_found; // depth of the last node found
+#define RBT_PROBE1(name, a)    DTRACE_PROBE1(rbt, name, a)
+#define RBT_PROBE2(name, a, b) DTRACE_PROBE2(rbt, name, a, b)
+#define RBT_PROBE_DOWN()       (RBT_probe_depth++)
+#define RBT_PROBE_UP()         (RBT_probe_depth--)
+#define RBT_PROBE_FOUND()      (RBT_probe_found = RBT_probe_depth)
+#else
+#define RBT_PROBE1(name, a)
+#define RBT_PROBE2(name, a, b)
+#define RBT_PROBE_DOWN()
+#define RBT_PROBE_UP()
+#define RBT_PROBE_FOUND()
+#endif // RBT_USDT
+
 //////////////////////////////////////////////////////////////////////////////
 // Tree Height                                                              //
 //////////////////////////////////////////////////////////////////////////////
@@ -59,6 +80,67 @@ int RBT_black_height(RBT root) {
     return RBT_black_height(root->left);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Cursors                                                                  //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Pushes `root` and its chain of left descendants onto the stack of
+// `cursor`, leaving the smallest node of `root` on top.
+void RBT_cursor_push_left(RBT_cursor *cursor, RBT root) {
+    while (root != NULL) {
+        cursor->stack[cursor->depth++] = root;
+        root = root->left;
+    }
+}
+
+// helper: Pops the top of the stack of `cursor` into the current node.
+RBT RBT_cursor_pop(RBT_cursor *cursor) {
+    if (cursor->depth == 0) {
+        cursor->node = NULL;
+    } else {
+        cursor->node = cursor->stack[--cursor->depth];
+    }
+    cursor->block = cursor->node;
+    return cursor->node;
+}
+
+RBT RBT_cursor_first(RBT_cursor *cursor, RBT root) {
+    cursor->depth = 0;
+    RBT_cursor_push_left(cursor, root);
+    return RBT_cursor_pop(cursor);
+}
+
+RBT RBT_cursor_seek_at_least(RBT_cursor *cursor, RBT root, unsigned int capacity) {
+    cursor->depth = 0;
+    while (root != NULL) {
+        if (root->capacity >= capacity) { // root is visited after root->left
+            cursor->stack[cursor->depth++] = root;
+            root = root->left;
+        } else { // root and root->left are too small
+            root = root->right;
+        }
+    }
+    return RBT_cursor_pop(cursor);
+}
+
+RBT RBT_cursor_next(RBT_cursor *cursor) {
+    if (cursor->node == NULL) {
+        return NULL;
+    }
+    RBT_cursor_push_left(cursor, cursor->node->right);
+    return RBT_cursor_pop(cursor);
+}
+
+RBT RBT_cursor_next_block(RBT_cursor *cursor) {
+    if (cursor->block == NULL) {
+        return NULL;
+    }
+    if (cursor->block->next != NULL) {
+        cursor->block = cursor->block->next;
+        return cursor->block;
+    }
+    return RBT_cursor_next(cursor);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // rep_ok: Functions for checking that an RBT satisfies the representation  //
 // invariant for Red-Black Trees:                                           //
@@ -126,6 +208,24 @@ void RBT_black_height_ok(RBT root) {
     RBT_black_height_ok(root->right);
 }
 
+// helper: Raises SIGABRT if the count of any tree node (see RBT_count) is
+// inconsistent with its linked list. Only the first two nodes of each list are
+// checked, so that the check takes O(1) time per tree node.
+void RBT_count_ok(RBT root) {
+    if (root == BLACK_LEAF) {
+        return;
+    }
+    RBT first = root->next;
+    if (first != NULL && (first->left == NULL ||
+            (first->next != NULL) != (RBT_count(root) > 2))) {
+        printf(RBT_ERROR "node with capacity %u has count %zu\n",
+                root->capacity, RBT_count(root));
+        raise(SIGABRT);
+    }
+    RBT_count_ok(root->left);
+    RBT_count_ok(root->right);
+}
+
 // Check the representation invariant for Red-Black Trees:
 //   + The root of the tree is BLACK.
 //   + If a node is RED, both children are BLACK.
@@ -156,6 +256,8 @@ RBT RBT_rep_ok(RBT root) {
     RBT_red_red_ok(root);
     // check black-height invariant
     RBT_black_height_ok(root);
+    // check the counts of the linked lists
+    RBT_count_ok(root);
 
     return root;
 }
@@ -183,6 +285,7 @@ RBT RBT_eliminate_red_red(RBT root) {
                 return root;
             }
             // case 2 : BLACK uncle -> rotate & recolor
+            RBT_PROBE2(rotate, (unsigned int)root->capacity, RBT_probe_depth);
             root->left = left->right;
             left->right = root;
             root->color = RED;
@@ -199,6 +302,7 @@ RBT RBT_eliminate_red_red(RBT root) {
                 return root;
             }
             // case 2 : BLACK uncle -> rotate & recolor
+            RBT_PROBE2(rotate, (unsigned int)root->capacity, RBT_probe_depth);
             root->left = left_right->right;
             left_right->right = root;
             left->right = left_right->left;
@@ -219,6 +323,7 @@ RBT RBT_eliminate_red_red(RBT root) {
                 return root;
             }
             // case 2 : BLACK uncle -> rotate & recolor
+            RBT_PROBE2(rotate, (unsigned int)root->capacity, RBT_probe_depth);
             root->right = right_left->left;
             right_left->left = root;
             right->left = right_left->right;
@@ -237,6 +342,7 @@ RBT RBT_eliminate_red_red(RBT root) {
                 return root;
             }
             // case 2 : BLACK uncle -> rotate & recolor
+            RBT_PROBE2(rotate, (unsigned int)root->capacity, RBT_probe_depth);
             root->right = right->left;
             right->left = root;
             root->color = RED;
@@ -251,6 +357,7 @@ RBT RBT_eliminate_red_red(RBT root) {
 // helper: recursive part of RBT_add.
 RBT RBT_add_inner(RBT root, RBT node, unsigned int capacity) {
     if (root == NULL) {
+        RBT_PROBE_FOUND();
         node->capacity = capacity;
         node->prev_dist = 0;
         node->left = NULL;
@@ -263,20 +370,22 @@ RBT RBT_add_inner(RBT root, RBT node, unsigned int capacity) {
 
     unsigned int c = root->capacity;
     if (capacity == c) { // add the new node to the linked-list
-        node = RBT_add_inner(NULL, node, capacity);
-        node->next = root->next;
-        root->next = node;
+        RBT_link_duplicate(root, RBT_add_inner(NULL, node, capacity));
         return root; // don't need to check for violations (linked-list)
     } else if (capacity < c) {
         RBT left = root->left;
+        RBT_PROBE_DOWN();
         RBT new_left = RBT_add_inner(left, node, capacity);
+        RBT_PROBE_UP();
         if (left == NULL) { // new_left is a newly allocated node with no children
             new_left->color = RED; // such added nodes are always RED
         }
         root->left = new_left;
     } else {
         RBT right = root->right;
+        RBT_PROBE_DOWN();
         RBT new_right = RBT_add_inner(right, node, capacity);
+        RBT_PROBE_UP();
         if (right == NULL) { // new_right is a newly allocated node with no children
             new_right->color = RED; // such added nodes are always RED
         }
@@ -294,11 +403,13 @@ RBT RBT_add(RBT root, RBT node, unsigned int capacity) {
     if (node == NULL) {
         return root;
     }
+    RBT_PROBE1(add_entry, capacity);
     RBT new_tree = RBT_add_inner(root, node, capacity);
     new_tree->color = BLACK;
     #ifdef ALLOC_TRACK
     NUM_NODES++;
     #endif // ALLOC_TRACK
+    RBT_PROBE2(add_return, capacity, RBT_probe_found);
     #ifdef REP_OK
     RBT_rep_ok(new_tree);
     #endif
@@ -316,10 +427,13 @@ RBT RBT_new(RBT root, unsigned int capacity) {
 //////////////////////////////////////////////////////////////////////////////
 // RBT Freeing                                                              //
 //////////////////////////////////////////////////////////////////////////////
-void RBT_free_list(RBT head) {
+// helper: Passes every node in the linked list starting with `head` to
+// `dealloc`.
+void RBT_destroy_list(RBT head, void (*dealloc)(void *context, RBT node),
+        void *context) {
     while (head != NULL) {
         RBT next = head->next;
-        free(head);
+        dealloc(context, head);
         #ifdef ALLOC_TRACK
         NUM_NODES--;
         #endif // ALLOC_TRACK
@@ -327,19 +441,98 @@ void RBT_free_list(RBT head) {
     }
 }
 
+// NOTE: RBT_destroy uses O(1) space by rotating each left child up to the
+// root until the root has no left child. The root (and its linked list) can
+// then be deallocated, and its right child becomes the new root. Each node is
+// rotated at most once, so this takes O(n) time.
+void RBT_destroy(RBT root, void (*dealloc)(void *context, RBT node),
+        void *context) {
+    while (root != NULL) {
+        RBT left = root->left;
+        if (left != NULL) { // rotate right
+            root->left = left->right;
+            left->right = root;
+            root = left;
+            continue;
+        }
+        RBT right = root->right;
+        RBT_destroy_list(root, dealloc, context);
+        root = right;
+    }
+}
+
+// helper: Deallocates `node` with free().
+void RBT_dealloc_free(void *context, RBT node) {
+    (void)context;
+    free(node);
+}
+
+void RBT_free_list(RBT head) {
+    RBT_destroy_list(head, RBT_dealloc_free, NULL);
+}
+
 void RBT_free(RBT root) {
-    if (root == NULL) {
+    RBT_destroy(root, RBT_dealloc_free, NULL);
+}
+
+// Nodes waiting to be passed to an allocator's `free_batch`.
+typedef struct RBT_batch {
+    const RBT_allocator *allocator;
+    size_t count;
+    RBT nodes[RBT_FREE_BATCH];
+} RBT_batch;
+
+// helper: Appends `node` to the RBT_batch `context`, passing the batch to the
+// allocator's `free_batch` whenever it is full.
+void RBT_batch_node(void *context, RBT node) {
+    RBT_batch *batch = context;
+    batch->nodes[batch->count++] = node;
+    if (batch->count == RBT_FREE_BATCH) {
+        batch->allocator->free_batch(batch->allocator->context, batch->nodes,
+                batch->count);
+        batch->count = 0;
+    }
+}
+
+// helper: Passes the nodes left in `batch` to the allocator's `free_batch`.
+void RBT_batch_flush(RBT_batch *batch) {
+    if (batch->count != 0) {
+        batch->allocator->free_batch(batch->allocator->context, batch->nodes,
+                batch->count);
+        batch->count = 0;
+    }
+}
+
+void RBT_free_list_with(RBT head, const RBT_allocator *allocator) {
+    if (allocator->free_batch == NULL) {
+        RBT_destroy_list(head, allocator->free_node, allocator->context);
         return;
     }
+    RBT_batch batch = {allocator, 0, {NULL}};
+    RBT_destroy_list(head, RBT_batch_node, &batch);
+    RBT_batch_flush(&batch);
+}
 
-    RBT_free(root->left);
-    RBT_free_list(root->next);
-    RBT_free(root->right);
+void RBT_free_with(RBT root, const RBT_allocator *allocator) {
+    if (allocator->free_batch == NULL) {
+        RBT_destroy(root, allocator->free_node, allocator->context);
+        return;
+    }
+    RBT_batch batch = {allocator, 0, {NULL}};
+    RBT_destroy(root, RBT_batch_node, &batch);
+    RBT_batch_flush(&batch);
+}
 
-    free(root);
+RBT RBT_forget(RBT root) {
+    (void)root;
     #ifdef ALLOC_TRACK
-    NUM_NODES--;
+    RBT_cursor cursor;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next_block(&cursor)) {
+        NUM_NODES--;
+    }
     #endif // ALLOC_TRACK
+    return BLACK_LEAF;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -401,6 +594,7 @@ RBT RBT_propagate_double_blackness(RBT root) {
             return right;
         }
         // Case B: propagate blackness upward
+        RBT_PROBE2(double_black, (unsigned int)root->capacity, RBT_probe_depth);
         if (root->color == BLACK) {
             root->color = DOUBLE_BLACK;
         } else {
@@ -454,6 +648,7 @@ RBT RBT_propagate_double_blackness(RBT root) {
             return left;
         }
         // Case B: propagate blackness upward
+        RBT_PROBE2(double_black, (unsigned int)root->capacity, RBT_probe_depth);
         if (root->color == BLACK) {
             root->color = DOUBLE_BLACK;
         } else {
@@ -587,11 +782,10 @@ RBT RBT_remove_empty_root(RBT root, RBT *removed) {
 // Propagates double-blackness to the root (if necessary).
 // Assumes: root is not NULL.
 RBT RBT_remove_root(RBT root, RBT *removed) {
-    RBT target = root->next;
+    RBT_PROBE_FOUND();
+    RBT target = RBT_remove_duplicate(root);
     if (target != NULL) { // root has multiple nodes with the target capacity
-        // remove a node from root's linked list and store it in `removed`
-        root->next = target->next;
-        target->next = NULL;
+        // a node was removed from root's linked list
         *removed = target;
         return root;
     }
@@ -599,10 +793,13 @@ RBT RBT_remove_root(RBT root, RBT *removed) {
     return RBT_remove_empty_root(root, removed);
 }
 
-// helper: recursive part of RBT_remove_at_least.
+// helper: recursive part of RBT_remove_at_least and RBT_remove_good_fit.
+// Any node whose capacity is within `slack` bytes of `capacity` is accepted
+// without descending further.
 // If the returned tree contains a doubly-black node, it will always be the
 // root.
-RBT RBT_remove_at_least_inner(RBT root, unsigned int capacity, RBT *removed) {
+RBT RBT_remove_at_least_inner(RBT root, unsigned int capacity,
+        unsigned int slack, RBT *removed) {
     if (root == NULL) {
         *removed = NULL;
         return NULL;
@@ -613,7 +810,12 @@ RBT RBT_remove_at_least_inner(RBT root, unsigned int capacity, RBT *removed) {
         // remove the root node and return the new root
         return RBT_remove_root(root, removed);
     } else if (capacity < c) { // root->left may have a better fitting node
-        RBT newleft = RBT_remove_at_least_inner(root->left, capacity, removed);
+        if (c - capacity <= slack) { // root is a good enough fit
+            return RBT_remove_root(root, removed);
+        }
+        RBT_PROBE_DOWN();
+        RBT newleft = RBT_remove_at_least_inner(root->left, capacity, slack, removed);
+        RBT_PROBE_UP();
         if (*removed == NULL) { // no nodes are a better fit than root
             // remove the root node and return the new root
             return RBT_remove_root(root, removed);
@@ -622,7 +824,9 @@ RBT RBT_remove_at_least_inner(RBT root, unsigned int capacity, RBT *removed) {
         return RBT_propagate_double_blackness(root);
     }
     // root is too small to fit `capacity`
-    RBT newright = RBT_remove_at_least_inner(root->right, capacity, removed);
+    RBT_PROBE_DOWN();
+    RBT newright = RBT_remove_at_least_inner(root->right, capacity, slack, removed);
+    RBT_PROBE_UP();
     if (*removed == NULL) { // no nodes in root->right are large enough
         return root;
     }
@@ -631,6 +835,11 @@ RBT RBT_remove_at_least_inner(RBT root, unsigned int capacity, RBT *removed) {
 }
 
 RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed) {
+    return RBT_remove_good_fit(root, capacity, 0, removed);
+}
+
+RBT RBT_remove_good_fit(RBT root, unsigned int capacity, unsigned int slack,
+        RBT *removed) {
     #ifdef REP_OK
     RBT_rep_ok(root);
     #endif
@@ -638,7 +847,8 @@ RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed) {
         return root;
     }
 
-    RBT newroot = RBT_remove_at_least_inner(root, capacity, removed);
+    RBT_PROBE2(remove_at_least_entry, capacity, slack);
+    RBT newroot = RBT_remove_at_least_inner(root, capacity, slack, removed);
     if (newroot == DOUBLE_BLACK_PTR) { // the tree is an empty DOUBLE-BLACK root
         // Unblacken the root
         newroot = BLACK_LEAF;
@@ -646,12 +856,22 @@ RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed) {
         // Blacken/unblacken the root
         newroot->color = BLACK;
     }
+    RBT_PROBE2(remove_at_least_return,
+            *removed == NULL ? 0u : (unsigned int)(*removed)->capacity, RBT_probe_found);
     #ifdef REP_OK
     return RBT_rep_ok(newroot);
     #endif
     return newroot;
 }
 
+unsigned int RBT_percent_slack(unsigned int capacity, unsigned int percent) {
+    unsigned long long slack = (unsigned long long)capacity * percent / 100;
+    if (slack > (unsigned int)-1) {
+        return (unsigned int)-1;
+    }
+    return slack;
+}
+
 // helper: Finds a node within `root` that is physically equivalent to `node`,
 // removes it, and stores it in `removed`.
 // If root has a non-NULL linked-list, then the first element is removed and
@@ -660,35 +880,17 @@ RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed) {
 // Propagates double-blackness to the root (if necessary).
 // Assumes: root is not NULL.
 RBT RBT_remove_node_root(RBT root, RBT node, RBT *removed) {
+    RBT_PROBE_FOUND();
     if (node != root) { // `node` can only be in `root`'s linked list
-        RBT prev_target = root;
-        RBT target = prev_target->next;
-        while (target != NULL) {
-            if (node == target) {
-                prev_target->next = target->next;
-                target->next = NULL;
-                *removed = target;
-                return root;
-            }
-            prev_target = target;
-            target = prev_target->next;
-        }
-        // { `node` is neither in `root` nor `root`'s linked list }
-        *removed = NULL;
+        // (if it is not, then it is neither in `root` nor its linked list)
+        *removed = RBT_unlink_duplicate(root, node) ? node : NULL;
         return root;
     }
     // { node == root }
-    RBT next = root->next;
-    if (next != NULL) { // there are other blocks with the same size as `root`
-        // we can replace `root` with `node`
+    if (root->next != NULL) { // there are other blocks with the same size as `root`
+        // we can replace `root` with the next one
         *removed = root;
-        next->left = root->left;
-        next->right = root->right;
-        next->color = root->color;
-        root->left = NULL;
-        root->right = NULL;
-        root->next = NULL;
-        return next;
+        return RBT_replace_head(root);
     }
     // we have to remove `root` from the tree
     root = RBT_remove_empty_root(root, removed);
@@ -709,11 +911,15 @@ RBT RBT_remove_node_inner(RBT root, RBT node, unsigned int capacity, RBT *remove
         // remove the root node and return the new root
         return RBT_remove_node_root(root, node, removed);
     } else if (capacity < c) { // root->left may have the target capacity
+        RBT_PROBE_DOWN();
         root->left = RBT_remove_node_inner(root->left, node, capacity, removed);
+        RBT_PROBE_UP();
         return RBT_propagate_double_blackness(root);
     }
     // root->right may have the target capacity
+    RBT_PROBE_DOWN();
     root->right = RBT_remove_node_inner(root->right, node, capacity, removed);
+    RBT_PROBE_UP();
     return RBT_propagate_double_blackness(root);
 }
 
@@ -729,6 +935,7 @@ RBT RBT_remove_node(RBT root, RBT node, RBT *removed) {
         return root;
     }
 
+    RBT_PROBE1(remove_node_entry, (unsigned int)node->capacity);
     RBT newroot = RBT_remove_node_inner(root, node, node->capacity, removed);
     if (newroot == DOUBLE_BLACK_PTR) { // the tree is an empty DOUBLE-BLACK root
         // Unblacken the root
@@ -737,12 +944,99 @@ RBT RBT_remove_node(RBT root, RBT node, RBT *removed) {
         // Blacken/unblacken the root
         newroot->color = BLACK;
     }
+    RBT_PROBE2(remove_node_return,
+            *removed == NULL ? 0u : (unsigned int)(*removed)->capacity, RBT_probe_found);
     #ifdef REP_OK
     return RBT_rep_ok(newroot);
     #endif
     return newroot;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// RBT Duplicates                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// NOTE: the length of a tree node's linked list is stored (as an integer) in
+// the `left` field of the first node in the list, and the `left` field of
+// every other node in the list is NULL.
+
+// helper: Returns the number of nodes in the linked list of `head`.
+size_t RBT_list_length(RBT head) {
+    return head->next == NULL ? 0 : (uintptr_t)head->next->left;
+}
+
+// helper: Stores the number of nodes in the linked list of `head` (which must
+// not be 0 unless the list is empty).
+void RBT_set_list_length(RBT head, size_t length) {
+    if (head->next != NULL) {
+        head->next->left = (RBT)(uintptr_t)length;
+    }
+}
+
+void RBT_add_duplicate(RBT head, RBT node) {
+    RBT_link_duplicate(head, RBT_add_inner(NULL, node, head->capacity));
+    #ifdef ALLOC_TRACK
+    NUM_NODES++;
+    #endif // ALLOC_TRACK
+}
+
+RBT RBT_remove_duplicate(RBT head) {
+    RBT target = head->next;
+    if (target != NULL) {
+        size_t length = RBT_list_length(head);
+        head->next = target->next;
+        target->next = NULL;
+        target->left = NULL;
+        RBT_set_list_length(head, length - 1);
+    }
+    return target;
+}
+
+size_t RBT_count(RBT head) {
+    if (head == NULL) {
+        return 0;
+    }
+    return 1 + RBT_list_length(head);
+}
+
+void RBT_link_duplicate(RBT head, RBT node) {
+    size_t length = RBT_list_length(head);
+    if (head->next != NULL) {
+        head->next->left = NULL;
+    }
+    node->next = head->next;
+    head->next = node;
+    RBT_set_list_length(head, length + 1);
+}
+
+bool RBT_unlink_duplicate(RBT head, RBT node) {
+    if (node == head->next) {
+        return RBT_remove_duplicate(head) != NULL;
+    }
+    size_t length = RBT_list_length(head);
+    for (RBT prev = head->next; prev != NULL; prev = prev->next) {
+        if (prev->next == node) {
+            prev->next = node->next;
+            node->next = NULL;
+            RBT_set_list_length(head, length - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+RBT RBT_replace_head(RBT head) {
+    RBT next = head->next;
+    size_t length = RBT_list_length(head);
+    next->left = head->left;
+    next->right = head->right;
+    next->color = head->color;
+    RBT_set_list_length(next, length - 1);
+    head->left = NULL;
+    head->right = NULL;
+    head->next = NULL;
+    return next;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // RBT Printing                                                             //
 //////////////////////////////////////////////////////////////////////////////
@@ -754,13 +1048,11 @@ void RBT_list_print(RBT head) {
 }
 
 void RBT_in_order_print(RBT root) {
-    if (root == NULL) {
-        return;
+    RBT_cursor cursor;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next(&cursor)) {
+        RBT_list_print(node);
     }
-    RBT_in_order_print(root->left);
-    printf("%u ", root->capacity);
-    RBT_list_print(root->next);
-    RBT_in_order_print(root->right);
 }
 
 // helper: Print a given node and its metadata.
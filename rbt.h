@@ -21,11 +21,31 @@
 //   - REP_OK           (severely slows performance)
 //     + Apply an internal representation invariant check to every RBT argument
 //       and return value (at runtime). Raises SIGABRT if violated.
+//
+//   - RBT_USDT         (a nop per probe, and a thread-local counter per level)
+//     + Place USDT probes (provider "rbt") for tracing with e.g. bpftrace.
+//       Requires <sys/sdt.h>. Depths count levels below the root (0); those
+//       of the return probes are where the node was linked (before
+//       rebalancing) or found, and are meaningless if nothing was removed.
+//         add_entry(capacity)
+//         add_return(capacity, depth)
+//         remove_at_least_entry(capacity, slack) (also RBT_remove_good_fit)
+//         remove_at_least_return(removed capacity or 0, depth)
+//         remove_node_entry(capacity)
+//         remove_node_return(removed capacity or 0, depth)
+//         rotate(capacity, depth): a rotation in RBT_add (at the subtree root)
+//         double_black(capacity, depth): double blackness moved up to a node
+//       e.g. bpftrace -e 'usdt:./rbt_bench:rbt:rotate { @[arg1] = count(); }'
 
 #ifndef RBT_H
 #define RBT_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define RED   1 // The RED color for an RBT node.
 #define BLACK 0 // The BLACK color for an RBT node.
@@ -33,17 +53,33 @@
 // A leaf node. Leaf nodes are NULL pointers and are, by definition, BLACK.
 #define BLACK_LEAF NULL
 
+// The maximum height of an RBT. An RBT with n nodes has height at most
+// 2 * log2(n + 1), and no more than 2^64 nodes can be addressed.
+#define RBT_MAX_HEIGHT 128
+
 // Red-Black Tree data type.
 // Every RBT node has a data block for dynamically allocating memory.
-typedef struct RBT {
-    struct RBT *left;  // pointer to the left child
-    struct RBT *right; // pointer to the right child
-    struct RBT *next;  // pointer to the next node with the same capacity
+// The block's fields come first, so that the links (which are only needed
+// while the node is in a tree) may overlay the start of a free block's payload
+// (see RBT_heap_init_split).
+//
+// C++ does not allow a typedef to share the name of its struct, so the struct
+// is named `RBT_node` when this header is included from C++.
+#ifdef __cplusplus
+#define RBT_STRUCT RBT_node
+#else
+#define RBT_STRUCT RBT
+#endif
+typedef struct RBT_STRUCT {
     unsigned int capacity  : 30; // number of bytes in the block (excluding the header)
     unsigned int prev_dist : 30; // distance (in bytes) to the previous header
     unsigned int in_use    :  1; // usage status of a block
     unsigned int color     :  2; // color of the RBT node (RED / BLACK)
+    struct RBT_STRUCT *left;  // pointer to the left child
+    struct RBT_STRUCT *right; // pointer to the right child
+    struct RBT_STRUCT *next;  // pointer to the next node with the same capacity
 }__attribute__((packed)) *RBT;
+#undef RBT_STRUCT
 
 // RBT_new returns a new RBT with the given `root` and initialized with
 // `capacity` (and no children).
@@ -76,6 +112,25 @@ RBT RBT_add(RBT root, RBT node, unsigned int capacity);
 // NOTE: the returned root is NULL if a node is removed from a singleton RBT.
 RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed);
 
+// RBT_remove_good_fit is like RBT_remove_at_least, but accepts the first node
+// found (while descending from the root) whose capacity is within `slack`
+// bytes of that requested, i.e. in [capacity, capacity + slack]. This shortens
+// the search (and any rebalancing below it) at the cost of returning a node
+// that may be up to `slack` bytes larger than the best fit. Only if no such
+// node is on the search path is the best fit removed. A `slack` of 0 is
+// equivalent to RBT_remove_at_least.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = RBT_remove_good_fit(tree, ..., ..., ...);
+RBT RBT_remove_good_fit(RBT root, unsigned int capacity, unsigned int slack,
+        RBT *removed);
+
+// RBT_percent_slack returns `percent` percent of `capacity` (rounded down),
+// for use as the `slack` argument of RBT_remove_good_fit when the tolerance is
+// relative to the request.
+//   e.g. tree = RBT_remove_good_fit(tree, c, RBT_percent_slack(c, 5), &removed);
+unsigned int RBT_percent_slack(unsigned int capacity, unsigned int percent);
+
 // RBT_remove_node removes the given node from the RBT with the given root and
 // stores it in the RBT variable `removed`. The new root is returned. If `node`
 // cannot be found in the tree, then the original root is returned and a NULL
@@ -88,6 +143,81 @@ RBT RBT_remove_at_least(RBT root, unsigned int capacity, RBT *removed);
 //   e.g. tree = RBT_remove_node(tree, ..., ..., ...);
 RBT RBT_remove_node(RBT root, RBT node, RBT *removed);
 
+// RBT_add_duplicate adds `node` to the linked list of `head`, a tree node with
+// the desired capacity, in O(1) time. It is equivalent to
+// RBT_add(root, node, head->capacity) without the search for `head`.
+void RBT_add_duplicate(RBT head, RBT node);
+
+// RBT_remove_duplicate removes a node from the linked list of the tree node
+// `head` in O(1) time and returns it, or returns NULL if `head` is the only
+// node with its capacity (in which case it must be removed with
+// RBT_remove_node).
+RBT RBT_remove_duplicate(RBT head);
+
+// RBT_count returns the number of nodes with the capacity of the tree node
+// `head` (i.e. `head` and its linked list) in O(1) time, or 0 if `head` is
+// NULL.
+//
+// NOTE: the count is kept in the `left` field of the first node in the linked
+// list (only tree nodes have children), so the `left` field of a node in a
+// linked list must not be modified.
+size_t RBT_count(RBT head);
+
+// The following functions maintain the linked list of a tree node (and its
+// count) for trees that share the RBT node type (e.g. wavl.h).
+
+// RBT_link_duplicate links `node`, which must already be initialized (as
+// RBT_add does), into the linked list of the tree node `head` in O(1) time.
+// Unlike RBT_add_duplicate, `node` is not counted by RBT_num_nodes.
+void RBT_link_duplicate(RBT head, RBT node);
+
+// RBT_unlink_duplicate removes `node` from the linked list of the tree node
+// `head`. Returns false (doing nothing) if `node` is not in the list.
+bool RBT_unlink_duplicate(RBT head, RBT node);
+
+// RBT_replace_head detaches the tree node `head` and returns the first node of
+// its linked list, which takes over the children and color of `head` and the
+// rest of the list. The result must replace `head` in its parent.
+// Assumes: head->next is not NULL.
+RBT RBT_replace_head(RBT head);
+
+// In-order cursor over an RBT.
+// A cursor visits every tree node (one per distinct capacity) in increasing
+// order of capacity without recursion, using an explicit stack of the
+// ancestors that remain to be visited. Each step does O(1) amortized (and
+// O(log n) worst-case) work, so a walk can be paused and resumed at any time.
+// `block` additionally steps through the linked list of `node`.
+//
+// NOTE: a cursor is invalidated by any modification of its tree (RBT_add,
+// RBT_remove_*, ...). Restart it with RBT_cursor_seek_at_least if necessary.
+typedef struct RBT_cursor {
+    RBT stack[RBT_MAX_HEIGHT]; // ancestors of `node` that are yet to be visited
+    int depth;                 // number of nodes in `stack`
+    RBT node;                  // the current tree node (NULL when done)
+    RBT block;                 // the current node in `node`'s linked list
+} RBT_cursor;
+
+// RBT_cursor_first positions `cursor` at the tree node of `root` with the
+// smallest capacity and returns it (or NULL if the tree is empty).
+RBT RBT_cursor_first(RBT_cursor *cursor, RBT root);
+
+// RBT_cursor_seek_at_least positions `cursor` at the tree node of `root` with
+// the smallest capacity that is at least that requested and returns it (or
+// NULL if there is no such node).
+RBT RBT_cursor_seek_at_least(RBT_cursor *cursor, RBT root, unsigned int capacity);
+
+// RBT_cursor_next advances `cursor` to the tree node with the next larger
+// capacity and returns it (or NULL if there is none). Any remaining nodes in
+// the current node's linked list are skipped.
+RBT RBT_cursor_next(RBT_cursor *cursor);
+
+// RBT_cursor_next_block advances `cursor` to the next node in the current
+// linked list or, at the end of the list, to the next tree node. Returns the
+// new `block` (or NULL if there is none). Starting from RBT_cursor_first, the
+// current block followed by repeated calls to RBT_cursor_next_block visit
+// every node in the tree in order (including duplicates).
+RBT RBT_cursor_next_block(RBT_cursor *cursor);
+
 // RBT_height returns the height of the RBT.
 // Tree height is defined as the *length* of the longest path from the root to
 // any non-leaf node. This is the same as the number of non-root, non-leaf
@@ -135,8 +265,53 @@ unsigned int RBT_num_nodes();
 void RBT_free_list(RBT head);
 
 // Free all nodes in a RBT with the given root, including it's children and any
-// linked-lists within each node.
+// linked-lists within each node. Uses O(1) stack space.
 void RBT_free(RBT root);
 
+//////////////////////////////////////////////////////////////////////////////
+// Functions for use with other allocators                                  //
+//////////////////////////////////////////////////////////////////////////////
+// RBT_destroy passes every node in the RBT with the given root (including
+// any linked-lists within each node) to `dealloc`, along with `context`. Nodes
+// are visited in no particular order, and their fields must not be used by
+// `dealloc` (the tree is dismantled as it is visited). Uses O(1) stack space.
+void RBT_destroy(RBT root, void (*dealloc)(void *context, RBT node),
+        void *context);
+
+// The number of nodes passed to an RBT_allocator's `free_batch` at once.
+#define RBT_FREE_BATCH 64
+
+// Node allocator hooks for RBT_free_list_with and RBT_free_with.
+// If `free_batch` is not NULL, then nodes are collected into arrays of up to
+// RBT_FREE_BATCH nodes, each of which is passed to `free_batch` (and
+// `free_node` is unused). Otherwise, each node is passed to `free_node`.
+// `context` is passed to both (e.g. a pointer to a pool or slab).
+typedef struct RBT_allocator {
+    void *context;
+    void (*free_node)(void *context, RBT node);
+    void (*free_batch)(void *context, RBT *nodes, size_t count);
+} RBT_allocator;
+
+// RBT_free_list_with is like RBT_free_list, but returns the nodes to the
+// given allocator instead of calling free.
+void RBT_free_list_with(RBT head, const RBT_allocator *allocator);
+
+// RBT_free_with is like RBT_free, but returns the nodes to the given
+// allocator instead of calling free. Nodes are returned in no particular
+// order, and their fields must not be used by the allocator.
+void RBT_free_with(RBT root, const RBT_allocator *allocator);
+
+// RBT_forget discards the RBT with the given root without visiting any of its
+// nodes, and returns an empty RBT. Use it when every node belongs to memory
+// that is released as a whole (e.g. an arena), so freeing nodes individually
+// is unnecessary. Runs in O(1) time (O(n) when compiled with -D ALLOC_TRACK,
+// to keep RBT_num_nodes() accurate).
+//   e.g. tree = RBT_forget(tree);
+RBT RBT_forget(RBT root);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* RBT_H */
 
@@ -0,0 +1,572 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt.hpp                                                                  //
+//////////////////////////////////////////////////////////////////////////////
+// rbt.hpp contains a C++ class template for intrusive Red-Black Trees of any
+// node type, keyed by one of its members:
+//
+//   struct Block : rbt::hook<Block> {
+//       unsigned int size;
+//   };
+//   rbt::intrusive_tree<Block, &Block::size> tree;
+//   tree.insert(&block);
+//   Block *fit = tree.remove_at_least(100);
+//
+// Like an RBT (see rbt.h), the tree never allocates: the links live in the
+// nodes (in their rbt::hook base), and nodes with equal keys are kept in a
+// linked list off the one node in the tree (the head). Unlike RBT_add & co.,
+// the algorithms are instantiated for each node type, key and comparator, so
+// the comparator (which must be default-constructible) and the key accessor
+// are inlined, and the tree object owns its root: it cannot be copied, and
+// there is no root to reassign after every call.
+//
+// The tree does not own its nodes. Destroying (or clearing) a tree leaves
+// them untouched, as RBT_forget does; use clear_and_dispose to free them.
+//
+// Conditional Compilation: with REP_OK defined, the representation invariant
+// is checked after every modification (raising SIGABRT if violated).
+
+#ifndef RBT_HPP
+#define RBT_HPP
+
+#include <cstddef>
+#include <csignal>
+#include <cstdio>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "rbt.h"
+
+#define RBT_HPP_ERROR "\033[31;1mError: \033[0m"
+
+namespace rbt {
+
+// Links of a node of an intrusive_tree. Node types derive from hook<Node>.
+template <class Node>
+struct hook {
+    Node *left = nullptr;  // left child
+    Node *right = nullptr; // right child
+    Node *next = nullptr;  // next node with an equal key
+    bool red = false;      // color of the node
+};
+
+namespace detail {
+
+// Key type of a pointer to a data member.
+template <class T>
+struct member_key;
+
+template <class Class, class Key>
+struct member_key<Key Class::*> {
+    using type = Key;
+};
+
+} // namespace detail
+
+// Intrusive Red-Black Tree of `Node`s ordered by `Node::*Key` using `Compare`.
+template <class Node, auto Key, class Compare = std::less<>>
+class intrusive_tree {
+    static_assert(std::is_base_of_v<hook<Node>, Node>,
+                  "Node must derive from rbt::hook<Node>");
+    static_assert(std::is_member_object_pointer_v<decltype(Key)>,
+                  "Key must point to a data member of Node");
+
+public:
+    using node_type = Node;
+    using key_type = typename detail::member_key<decltype(Key)>::type;
+    using key_compare = Compare;
+
+    intrusive_tree() noexcept = default;
+    intrusive_tree(const intrusive_tree &) = delete;
+    intrusive_tree &operator=(const intrusive_tree &) = delete;
+
+    intrusive_tree(intrusive_tree &&other) noexcept
+        : root_(std::exchange(other.root_, nullptr)),
+          size_(std::exchange(other.size_, 0)) {}
+
+    // Forgets the nodes of this tree (as clear does) before taking the other's.
+    intrusive_tree &operator=(intrusive_tree &&other) noexcept {
+        if (this != &other) {
+            root_ = std::exchange(other.root_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    ~intrusive_tree() = default;
+
+    // Returns true if the tree has no nodes.
+    bool empty() const noexcept { return root_ == nullptr; }
+
+    // Returns the number of nodes in the tree (including duplicates).
+    std::size_t size() const noexcept { return size_; }
+
+    // Returns the root of the tree (NULL if empty).
+    const Node *root() const noexcept { return root_; }
+
+    // Inserts `node` (which must not be in a tree) and initializes its links.
+    // Nodes with equal keys are linked to the head, most recent first.
+    void insert(Node *node) noexcept {
+        Node *path[MAX_PATH];
+        int depth = 0;
+        Node **link = &root_;
+        const key_type &key = key_of(node);
+        size_++;
+        while (*link != nullptr) {
+            Node *current = *link;
+            if (less(key, key_of(current))) {
+                link = &current->left;
+            } else if (less(key_of(current), key)) {
+                link = &current->right;
+            } else {
+                node->left = nullptr;
+                node->right = nullptr;
+                node->red = false;
+                node->next = current->next;
+                current->next = node;
+                check();
+                return;
+            }
+            path[depth++] = current;
+        }
+        node->left = nullptr;
+        node->right = nullptr;
+        node->next = nullptr;
+        node->red = true;
+        *link = node;
+        insert_fixup(path, depth, node);
+        check();
+    }
+
+    // Returns the head of the nodes whose key is equal to `key` (NULL if none).
+    Node *find(const key_type &key) const noexcept {
+        Node *current = root_;
+        while (current != nullptr) {
+            if (less(key, key_of(current))) {
+                current = current->left;
+            } else if (less(key_of(current), key)) {
+                current = current->right;
+            } else {
+                return current;
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns the head of the nodes with the smallest key that is not less
+    // than `key` (NULL if none).
+    Node *lower_bound(const key_type &key) const noexcept {
+        Node *current = root_;
+        Node *bound = nullptr;
+        while (current != nullptr) {
+            if (less(key_of(current), key)) {
+                current = current->right;
+            } else {
+                bound = current;
+                current = current->left;
+            }
+        }
+        return bound;
+    }
+
+    // Removes and returns a node with the smallest key that is not less than
+    // `key` (NULL if none), taking duplicates first, as RBT_remove_at_least
+    // does.
+    Node *remove_at_least(const key_type &key) noexcept {
+        Node *path[MAX_PATH];
+        int depth = 0;
+        int bound_depth = -1;
+        Node *current = root_;
+        while (current != nullptr) {
+            path[depth] = current;
+            if (less(key_of(current), key)) {
+                current = current->right;
+            } else {
+                bound_depth = depth;
+                current = current->left;
+            }
+            depth++;
+        }
+        if (bound_depth < 0) {
+            return nullptr;
+        }
+        Node *head = path[bound_depth];
+        size_--;
+        Node *removed = head->next;
+        if (removed != nullptr) {
+            head->next = removed->next;
+        } else {
+            removed = head;
+            erase(path, bound_depth);
+        }
+        removed->next = nullptr;
+        check();
+        return removed;
+    }
+
+    // Removes `node` from the tree. Returns false (without modifying the tree)
+    // if it is not in the tree.
+    bool remove(Node *node) noexcept {
+        Node *path[MAX_PATH];
+        int depth = 0;
+        Node *current = root_;
+        const key_type &key = key_of(node);
+        while (current != nullptr) {
+            if (less(key, key_of(current))) {
+                path[depth++] = current;
+                current = current->left;
+            } else if (less(key_of(current), key)) {
+                path[depth++] = current;
+                current = current->right;
+            } else {
+                break;
+            }
+        }
+        if (current == nullptr) {
+            return false;
+        }
+        path[depth] = current;
+        if (current != node) {
+            // unlink it from the head's list
+            while (current->next != node) {
+                if (current->next == nullptr) {
+                    return false;
+                }
+                current = current->next;
+            }
+            current->next = node->next;
+        } else if (node->next != nullptr) {
+            // the first duplicate becomes the head
+            Node *head = node->next;
+            head->left = node->left;
+            head->right = node->right;
+            head->red = node->red;
+            *link_to(path, depth) = head;
+        } else {
+            path[depth] = node;
+            erase(path, depth);
+        }
+        node->left = nullptr;
+        node->right = nullptr;
+        node->next = nullptr;
+        size_--;
+        check();
+        return true;
+    }
+
+    // Calls `visit(node)` for every node, in order of their keys (duplicates
+    // after their head, most recent first).
+    template <class Visit>
+    void for_each(Visit visit) const {
+        Node *path[MAX_PATH];
+        int depth = 0;
+        Node *current = root_;
+        while (current != nullptr || depth > 0) {
+            while (current != nullptr) {
+                path[depth++] = current;
+                current = current->left;
+            }
+            current = path[--depth];
+            for (Node *node = current; node != nullptr; node = node->next) {
+                visit(node);
+            }
+            current = current->right;
+        }
+    }
+
+    // Empties the tree without touching its nodes (cf. RBT_forget).
+    void clear() noexcept {
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+    // Empties the tree and calls `dispose(node)` for every node, after which
+    // the node is no longer accessed (so it may be freed).
+    template <class Dispose>
+    void clear_and_dispose(Dispose dispose) {
+        Node *path[MAX_PATH];
+        int depth = 0;
+        Node *current = std::exchange(root_, nullptr);
+        size_ = 0;
+        // unlink each head from its parent before disposing of its subtrees
+        while (current != nullptr || depth > 0) {
+            if (current == nullptr) {
+                current = path[--depth];
+            }
+            if (current->left != nullptr) {
+                path[depth++] = current;
+                current = std::exchange(current->left, nullptr);
+                continue;
+            }
+            Node *right = current->right;
+            Node *node = current;
+            while (node != nullptr) {
+                Node *next = node->next;
+                dispose(node);
+                node = next;
+            }
+            current = right;
+        }
+    }
+
+    // Returns the number of nodes on the longest path from the root to a
+    // leaf (cf. RBT_height).
+    int height() const noexcept { return height(root_); }
+
+    // Checks the representation invariant of the tree (ordered keys, black
+    // root, red-red and black-height invariants, lists of equal keys and the
+    // node count). Raises SIGABRT if violated.
+    void rep_ok() const {
+        if (root_ != nullptr && root_->red) {
+            std::printf(RBT_HPP_ERROR "tree does not satisfy black root invariant\n");
+            std::raise(SIGABRT);
+        }
+        std::size_t count = 0;
+        black_height(root_, nullptr, nullptr, &count);
+        if (count != size_) {
+            std::printf(RBT_HPP_ERROR "tree has %zu nodes but size %zu\n", count, size_);
+            std::raise(SIGABRT);
+        }
+    }
+
+private:
+    // Longest path stored while walking the tree (one more than the longest
+    // path of an RBT, because deletion may push a rotated node).
+    static constexpr int MAX_PATH = RBT_MAX_HEIGHT + 1;
+
+    static const key_type &key_of(const Node *node) noexcept { return node->*Key; }
+
+    static bool less(const key_type &a, const key_type &b) noexcept {
+        return Compare{}(a, b);
+    }
+
+    static bool is_red(const Node *node) noexcept {
+        return node != nullptr && node->red;
+    }
+
+    // Returns the link to path[depth] (the root or a child of path[depth - 1]).
+    Node **link_to(Node **path, int depth) noexcept {
+        if (depth == 0) {
+            return &root_;
+        }
+        Node *parent = path[depth - 1];
+        return parent->left == path[depth] ? &parent->left : &parent->right;
+    }
+
+    // Restores the red-red invariant after `node` (red) was linked below
+    // path[depth - 1].
+    void insert_fixup(Node **path, int depth, Node *node) noexcept {
+        // a red parent is never the root, so it has a parent
+        while (depth > 0 && path[depth - 1]->red) {
+            Node *parent = path[depth - 1];
+            Node *grand = path[depth - 2];
+            Node *uncle = grand->left == parent ? grand->right : grand->left;
+            if (is_red(uncle)) {
+                // recolor and continue from the grandparent
+                parent->red = false;
+                uncle->red = false;
+                grand->red = true;
+                node = grand;
+                depth -= 2;
+                continue;
+            }
+            Node **grand_link = link_to(path, depth - 2);
+            if (grand->left == parent) {
+                if (parent->right == node) {
+                    parent->right = node->left;
+                    node->left = parent;
+                    std::swap(node, parent);
+                }
+                grand->left = parent->right;
+                parent->right = grand;
+            } else {
+                if (parent->left == node) {
+                    parent->left = node->right;
+                    node->right = parent;
+                    std::swap(node, parent);
+                }
+                grand->right = parent->left;
+                parent->left = grand;
+            }
+            // parent is the new root of the subtree
+            parent->red = false;
+            grand->red = true;
+            *grand_link = parent;
+            break;
+        }
+        root_->red = false;
+    }
+
+    // Removes path[depth] (a head without duplicates) from the tree, given the
+    // path to it, and restores the invariant.
+    void erase(Node **path, int depth) noexcept {
+        Node *node = path[depth];
+        Node **node_link = link_to(path, depth);
+        Node *child;           // takes the place of the unlinked node
+        Node **child_link;     // link to `child`
+        bool removed_red;      // color of the unlinked node
+        if (node->left != nullptr && node->right != nullptr) {
+            // unlink the successor instead, and move it to node's place
+            int node_depth = depth++;
+            Node *swap = node->right;
+            Node **swap_link = &node->right;
+            while (swap->left != nullptr) {
+                path[depth++] = swap;
+                swap_link = &swap->left;
+                swap = swap->left;
+            }
+            path[node_depth] = swap;
+            child = swap->right;
+            removed_red = swap->red;
+            swap->red = node->red;
+            swap->left = node->left;
+            if (swap_link == &node->right) {
+                child_link = &swap->right;
+            } else {
+                *swap_link = child;
+                child_link = swap_link;
+                swap->right = node->right;
+            }
+            *node_link = swap;
+        } else {
+            child = node->left != nullptr ? node->left : node->right;
+            removed_red = node->red;
+            *node_link = child;
+            child_link = node_link;
+        }
+        if (!removed_red) {
+            erase_fixup(path, depth, child,
+                        depth > 0 && child_link == &path[depth - 1]->left);
+        }
+    }
+
+    // Restores the black-height invariant after a black node was unlinked
+    // and replaced with `node` (the left child of path[depth - 1] if `left`),
+    // which is missing one black node.
+    void erase_fixup(Node **path, int depth, Node *node, bool left) noexcept {
+        while (depth > 0 && !is_red(node)) {
+            Node *parent = path[depth - 1];
+            Node **parent_link = link_to(path, depth - 1);
+            // the sibling is not NULL, since its subtree has a black node more
+            Node *sibling = left ? parent->right : parent->left;
+            if (sibling->red) {
+                // rotate the sibling above the parent, so the new one is black
+                sibling->red = false;
+                parent->red = true;
+                if (left) {
+                    parent->right = sibling->left;
+                    sibling->left = parent;
+                } else {
+                    parent->left = sibling->right;
+                    sibling->right = parent;
+                }
+                *parent_link = sibling;
+                parent_link = left ? &sibling->left : &sibling->right;
+                path[depth - 1] = sibling;
+                path[depth++] = parent;
+                sibling = left ? parent->right : parent->left;
+            }
+            Node *near = left ? sibling->left : sibling->right;
+            Node *far = left ? sibling->right : sibling->left;
+            if (!is_red(near) && !is_red(far)) {
+                // move the missing black node up to the parent
+                sibling->red = true;
+                node = parent;
+                depth--;
+                left = depth > 0 && path[depth - 1]->left == node;
+                continue;
+            }
+            if (!is_red(far)) {
+                // rotate the near nephew above the sibling, so the far one is red
+                near->red = false;
+                sibling->red = true;
+                if (left) {
+                    sibling->left = near->right;
+                    near->right = sibling;
+                    parent->right = near;
+                } else {
+                    sibling->right = near->left;
+                    near->left = sibling;
+                    parent->left = near;
+                }
+                far = sibling;
+                sibling = near;
+            }
+            // rotate the sibling above the parent, which becomes the black
+            // node that was missing
+            sibling->red = parent->red;
+            parent->red = false;
+            far->red = false;
+            if (left) {
+                parent->right = sibling->left;
+                sibling->left = parent;
+            } else {
+                parent->left = sibling->right;
+                sibling->right = parent;
+            }
+            *parent_link = sibling;
+            return;
+        }
+        if (node != nullptr) {
+            node->red = false;
+        }
+    }
+
+    // helper: Returns the height of the subtree at `root`.
+    static int height(const Node *root) noexcept {
+        if (root == nullptr) {
+            return 0;
+        }
+        int left = height(root->left);
+        int right = height(root->right);
+        return 1 + (left > right ? left : right);
+    }
+
+    // helper: Returns the black height of the subtree at `root`, whose keys
+    // must be in [min, max] (if not NULL), and adds its nodes to `count`.
+    static int black_height(const Node *root, const Node *min, const Node *max,
+                            std::size_t *count) {
+        if (root == nullptr) {
+            return 0;
+        }
+        if ((min != nullptr && less(key_of(root), key_of(min))) ||
+            (max != nullptr && less(key_of(max), key_of(root)))) {
+            std::printf(RBT_HPP_ERROR "tree does not satisfy BST invariant\n");
+            std::raise(SIGABRT);
+        }
+        if (root->red && (is_red(root->left) || is_red(root->right))) {
+            std::printf(RBT_HPP_ERROR "tree does not satisfy red-red invariant\n");
+            std::raise(SIGABRT);
+        }
+        for (const Node *node = root; node != nullptr; node = node->next) {
+            if (node != root && (less(key_of(node), key_of(root)) ||
+                                 less(key_of(root), key_of(node)))) {
+                std::printf(RBT_HPP_ERROR "duplicate list contains another key\n");
+                std::raise(SIGABRT);
+            }
+            (*count)++;
+        }
+        int left = black_height(root->left, min, root, count);
+        int right = black_height(root->right, root, max, count);
+        if (left != right) {
+            std::printf(RBT_HPP_ERROR
+                        "tree does not satisfy black height invariant\n");
+            std::raise(SIGABRT);
+        }
+        return left + !root->red;
+    }
+
+    // helper: Checks the invariant if REP_OK is defined.
+    void check() const {
+#ifdef REP_OK
+        rep_ok();
+#endif
+    }
+
+    Node *root_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace rbt
+
+#endif /* RBT_HPP */
@@ -0,0 +1,1209 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_bench.c                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_bench.c contains benchmarks for RBT operations. Each benchmark prints a
+// small table of its results. Build and run with "make bench".
+#define _GNU_SOURCE // pthread_setaffinity_np
+#include "rbt.h"
+#include "bpt.h"
+#include "rbt_fit.h"
+#include "rbt_heap.h"
+#include "rbt_snapshot.h"
+#include "rbt_mru.h"
+#include "rbt_hash.h"
+#include "rbt_parallel.h"
+#include "rbt_numa.h"
+#include "rbt_slab.h"
+#include "rbt_region.h"
+#include "rbt_handle.h"
+#include "wavl.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#define BENCH_NODES 1000000 // number of free blocks in the benchmarked trees
+#define BENCH_OPS   2000000 // number of requests per benchmark run
+
+#define BENCH_MIN_SIZE 16    // smallest block size
+#define BENCH_MAX_SIZE 65536 // (exclusive) largest block size
+
+#define BENCH_HEAP_SIZE   (128 << 20) // number of bytes in benchmarked heaps
+#define BENCH_TRACE_OPS   2000000     // length of the generated trace
+#define BENCH_TRACE_LIVE  20000       // live allocations in the generated trace
+
+#define BENCH_BURST_SIZES 4096 // distinct capacities in the bursty benchmark
+#define BENCH_BURST_HOT   16   // capacities that most bursts request
+#define BENCH_BURST       32   // number of requests per burst
+
+#define BENCH_EXACT_SIZES 65536 // distinct capacities in the exact-fit benchmark
+
+#define BENCH_NUMA_ARENA (256 << 20) // number of bytes in each NUMA arena
+#define BENCH_NUMA_OPS   1000000     // requests per thread in the NUMA benchmark
+#define BENCH_NUMA_LIVE  1000        // live allocations per thread
+
+#define BENCH_SLAB_OBJECT 64     // size of the objects in the slab benchmark
+#define BENCH_SLAB_LIVE   100000 // live objects in the slab benchmark
+
+#define BENCH_REQUESTS    10000 // requests in the region benchmark
+#define BENCH_SCRATCH     256   // scratch objects allocated per request
+
+#define BENCH_HANDLES     60000  // relocatable objects in the compaction benchmark
+
+// helper: Returns a random block size in [BENCH_MIN_SIZE, BENCH_MAX_SIZE).
+unsigned int random_size() {
+    return BENCH_MIN_SIZE + rand() % (BENCH_MAX_SIZE - BENCH_MIN_SIZE);
+}
+
+// helper: Returns the number of seconds between `begin` and `end`.
+double seconds(clock_t begin, clock_t end) {
+    return (double)(end - begin) / CLOCKS_PER_SEC;
+}
+
+// helper: Returns the current wall-clock time (in seconds).
+double wall_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Good-Fit Tolerance                                                       //
+//////////////////////////////////////////////////////////////////////////////
+// Measure the throughput of RBT_remove_good_fit and the number of bytes it
+// wastes (beyond the best fit) for several tolerances. Every removed node is
+// re-added with the same capacity so that the tree stays the same size.
+void good_fit_bench() {
+    struct {
+        const char *name;
+        unsigned int slack;   // absolute slack (in bytes)
+        unsigned int percent; // slack relative to the request (in percent)
+    } configs[] = {
+        {"best fit",   0,    0},
+        {"slack 64",   64,   0},
+        {"slack 1024", 1024, 0},
+        {"slack 1%",   0,    1},
+        {"slack 5%",   0,    5},
+        {"slack 25%",  0,    25},
+    };
+
+    struct RBT *nodes = malloc(BENCH_NODES * sizeof(struct RBT));
+    if (nodes == NULL) {
+        printf("good_fit_bench: out of memory\n");
+        return;
+    }
+
+    printf("Good-fit tolerance (%d nodes, %d requests)\n", BENCH_NODES, BENCH_OPS);
+    printf("  %-12s %10s %12s %12s\n", "policy", "ns/op", "waste/req", "waste %");
+    for (int i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        srand(1);
+        RBT tree = NULL;
+        for (unsigned int j = 0; j < BENCH_NODES; j++) {
+            tree = RBT_add(tree, &nodes[j], random_size());
+        }
+
+        unsigned long long requested_bytes = 0;
+        unsigned long long wasted_bytes = 0;
+        clock_t begin = clock();
+        for (unsigned int j = 0; j < BENCH_OPS; j++) {
+            unsigned int requested = random_size();
+            unsigned int slack = configs[i].slack;
+            if (configs[i].percent != 0) {
+                slack = RBT_percent_slack(requested, configs[i].percent);
+            }
+            RBT removed;
+            tree = RBT_remove_good_fit(tree, requested, slack, &removed);
+            if (removed != NULL) {
+                unsigned int capacity = removed->capacity;
+                requested_bytes += requested;
+                wasted_bytes += capacity - requested;
+                tree = RBT_add(tree, removed, capacity);
+            }
+        }
+        clock_t end = clock();
+
+        printf("  %-12s %10.1f %12.1f %11.3f%%\n", configs[i].name,
+                seconds(begin, end) * 1e9 / BENCH_OPS,
+                (double)wasted_bytes / BENCH_OPS,
+                100.0 * wasted_bytes / requested_bytes);
+    }
+    printf("\n");
+    free(nodes);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Index Backends                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// Compare the throughput of best-fit removal and re-insertion for each index
+// backend, with (nearly) every capacity distinct so that the trees are as
+// large as possible.
+void index_bench() {
+    struct RBT *nodes = malloc(BENCH_NODES * sizeof(struct RBT));
+    unsigned int *requests = malloc(BENCH_OPS * sizeof(unsigned int));
+    if (nodes == NULL || requests == NULL) {
+        printf("index_bench: out of memory\n");
+        free(nodes);
+        free(requests);
+        return;
+    }
+    srand(2);
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        requests[j] = rand() % (1 << 24);
+    }
+
+    printf("Index backends (%d nodes, %d requests)\n", BENCH_NODES, BENCH_OPS);
+    printf("  %-12s %10s %10s %10s\n", "backend", "build s", "ns/op", "height");
+
+    srand(1);
+    clock_t begin = clock();
+    RBT rbt = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        rbt = RBT_add(rbt, &nodes[j], rand() % (1 << 24));
+    }
+    clock_t middle = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT removed;
+        rbt = RBT_remove_at_least(rbt, requests[j], &removed);
+        if (removed != NULL) {
+            rbt = RBT_add(rbt, removed, removed->capacity);
+        }
+    }
+    clock_t end = clock();
+    printf("  %-12s %10.3f %10.1f %10d\n", "RBT", seconds(begin, middle),
+            seconds(middle, end) * 1e9 / BENCH_OPS, RBT_height(rbt));
+
+    srand(1);
+    begin = clock();
+    RBT wavl = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        wavl = WAVL_add(wavl, &nodes[j], rand() % (1 << 24));
+    }
+    middle = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT removed;
+        wavl = WAVL_remove_at_least(wavl, requests[j], &removed);
+        if (removed != NULL) {
+            wavl = WAVL_add(wavl, removed, removed->capacity);
+        }
+    }
+    end = clock();
+    printf("  %-12s %10.3f %10.1f %10d\n", "WAVL", seconds(begin, middle),
+            seconds(middle, end) * 1e9 / BENCH_OPS, RBT_height(wavl));
+
+    srand(1);
+    begin = clock();
+    BPT bpt = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        bpt = BPT_add(bpt, &nodes[j], rand() % (1 << 24));
+    }
+    middle = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT removed;
+        bpt = BPT_remove_at_least(bpt, requests[j], &removed);
+        if (removed != NULL) {
+            bpt = BPT_add(bpt, removed, removed->capacity);
+        }
+    }
+    end = clock();
+    printf("  %-12s %10.3f %10.1f %10d\n", "BPT", seconds(begin, middle),
+            seconds(middle, end) * 1e9 / BENCH_OPS, BPT_height(bpt));
+    BPT_destroy(bpt, NULL, NULL);
+
+    printf("\n");
+    free(requests);
+    free(nodes);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Snapshots                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// Compare the time to answer "smallest capacity of at least N" queries from
+// an Eytzinger snapshot with a search of the live RBT.
+void snapshot_bench() {
+    struct RBT *nodes = malloc(BENCH_NODES * sizeof(struct RBT));
+    unsigned int *requests = malloc(BENCH_OPS * sizeof(unsigned int));
+    if (nodes == NULL || requests == NULL) {
+        printf("snapshot_bench: out of memory\n");
+        free(nodes);
+        free(requests);
+        return;
+    }
+    srand(1);
+    RBT tree = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        tree = RBT_add(tree, &nodes[j], rand() % (1 << 24));
+    }
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        requests[j] = rand() % (1 << 24);
+    }
+
+    clock_t begin = clock();
+    RBT_snapshot snapshot = RBT_snapshot_new(tree);
+    clock_t end = clock();
+    printf("Snapshots (%d nodes, %zu distinct, %d queries)\n", BENCH_NODES,
+            snapshot->size, BENCH_OPS);
+    printf("  build: %.3f s\n", seconds(begin, end));
+    printf("  %-12s %10s\n", "query", "ns/query");
+
+    unsigned long long sum = 0;
+    begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        sum += RBT_snapshot_lower_bound(snapshot, requests[j]);
+    }
+    end = clock();
+    printf("  %-12s %10.1f\n", "snapshot", seconds(begin, end) * 1e9 / BENCH_OPS);
+
+    unsigned long long tree_sum = 0;
+    RBT_cursor cursor;
+    begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT node = RBT_cursor_seek_at_least(&cursor, tree, requests[j]);
+        tree_sum += node == NULL ? 0 : node->capacity;
+    }
+    end = clock();
+    printf("  %-12s %10.1f\n", "RBT", seconds(begin, end) * 1e9 / BENCH_OPS);
+    if (sum != tree_sum) {
+        printf("  (results differ!)\n");
+    }
+
+    printf("\n");
+    RBT_snapshot_free(snapshot);
+    free(requests);
+    free(nodes);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Bursty Requests                                                          //
+//////////////////////////////////////////////////////////////////////////////
+// Compare an RBT with an MRU-cached RBT on bursts of requests: each burst
+// removes BENCH_BURST blocks of one capacity and then adds them back. Nine in
+// ten bursts request one of a few hot capacities.
+void mru_bench() {
+    struct RBT *nodes = malloc(BENCH_NODES * sizeof(struct RBT));
+    unsigned int *capacities = malloc(BENCH_NODES * sizeof(unsigned int));
+    unsigned int *requests = malloc(BENCH_OPS / BENCH_BURST * sizeof(unsigned int));
+    if (nodes == NULL || capacities == NULL || requests == NULL) {
+        printf("mru_bench: out of memory\n");
+        free(nodes);
+        free(capacities);
+        free(requests);
+        return;
+    }
+    srand(1);
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        capacities[j] = BENCH_MIN_SIZE + 16 * (rand() % BENCH_BURST_SIZES);
+    }
+    for (unsigned int j = 0; j < BENCH_OPS / BENCH_BURST; j++) {
+        unsigned int size = rand() % 10 == 0 ? rand() % BENCH_BURST_SIZES :
+                rand() % BENCH_BURST_HOT * (BENCH_BURST_SIZES / BENCH_BURST_HOT);
+        requests[j] = BENCH_MIN_SIZE + 16 * size;
+    }
+
+    printf("Bursty requests (%d nodes, %d distinct, %d requests in bursts of %d)\n",
+            BENCH_NODES, BENCH_BURST_SIZES, BENCH_OPS, BENCH_BURST);
+    printf("  %-12s %10s %10s\n", "index", "ns/op", "hit %");
+
+    RBT held[BENCH_BURST];
+    RBT tree = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        tree = RBT_add(tree, &nodes[j], capacities[j]);
+    }
+    clock_t begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS / BENCH_BURST; j++) {
+        for (int k = 0; k < BENCH_BURST; k++) {
+            tree = RBT_remove_at_least(tree, requests[j], &held[k]);
+        }
+        for (int k = 0; k < BENCH_BURST; k++) {
+            if (held[k] != NULL) {
+                tree = RBT_add(tree, held[k], held[k]->capacity);
+            }
+        }
+    }
+    clock_t end = clock();
+    printf("  %-12s %10.1f %10s\n", "RBT",
+            seconds(begin, end) * 1e9 / (2 * BENCH_OPS), "-");
+
+    RBT_mru mru;
+    RBT_mru_init(&mru);
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        RBT_mru_add(&mru, &nodes[j], capacities[j]);
+    }
+    mru.hits = 0;
+    mru.misses = 0;
+    begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS / BENCH_BURST; j++) {
+        for (int k = 0; k < BENCH_BURST; k++) {
+            held[k] = RBT_mru_remove_at_least(&mru, requests[j]);
+        }
+        for (int k = 0; k < BENCH_BURST; k++) {
+            if (held[k] != NULL) {
+                RBT_mru_add(&mru, held[k], held[k]->capacity);
+            }
+        }
+    }
+    end = clock();
+    printf("  %-12s %10.1f %10.1f\n", "RBT + MRU",
+            seconds(begin, end) * 1e9 / (2 * BENCH_OPS),
+            100.0 * mru.hits / (mru.hits + mru.misses));
+
+    printf("\n");
+    free(requests);
+    free(capacities);
+    free(nodes);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Exact Fits                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// Compare an RBT with a hash-indexed RBT on requests for capacities that are
+// in the tree (nine in ten) or are not (one in ten). Each request removes a
+// block and adds it back.
+void exact_bench() {
+    struct RBT *nodes = malloc(BENCH_NODES * sizeof(struct RBT));
+    unsigned int *capacities = malloc(BENCH_NODES * sizeof(unsigned int));
+    unsigned int *requests = malloc(BENCH_OPS * sizeof(unsigned int));
+    if (nodes == NULL || capacities == NULL || requests == NULL) {
+        printf("exact_bench: out of memory\n");
+        free(nodes);
+        free(capacities);
+        free(requests);
+        return;
+    }
+    srand(1);
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        capacities[j] = BENCH_MIN_SIZE + 16 * (rand() % BENCH_EXACT_SIZES);
+    }
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        requests[j] = rand() % 10 == 0 ? rand() % (16 * BENCH_EXACT_SIZES) :
+                capacities[rand() % BENCH_NODES];
+    }
+
+    printf("Exact fits (%d nodes, %d distinct, %d requests)\n",
+            BENCH_NODES, BENCH_EXACT_SIZES, BENCH_OPS);
+    printf("  %-12s %10s %10s\n", "index", "ns/op", "hit %");
+
+    RBT tree = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        tree = RBT_add(tree, &nodes[j], capacities[j]);
+    }
+    clock_t begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT removed;
+        tree = RBT_remove_at_least(tree, requests[j], &removed);
+        if (removed != NULL) {
+            tree = RBT_add(tree, removed, removed->capacity);
+        }
+    }
+    clock_t end = clock();
+    printf("  %-12s %10.1f %10s\n", "RBT",
+            seconds(begin, end) * 1e9 / BENCH_OPS, "-");
+
+    RBT_hash hash;
+    if (!RBT_hash_init(&hash)) {
+        printf("exact_bench: out of memory\n");
+        free(requests);
+        free(capacities);
+        free(nodes);
+        return;
+    }
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        RBT_hash_add(&hash, &nodes[j], capacities[j]);
+    }
+    hash.hits = 0;
+    hash.misses = 0;
+    begin = clock();
+    for (unsigned int j = 0; j < BENCH_OPS; j++) {
+        RBT removed = RBT_hash_remove_at_least(&hash, requests[j]);
+        if (removed != NULL) {
+            RBT_hash_add(&hash, removed, removed->capacity);
+        }
+    }
+    end = clock();
+    printf("  %-12s %10.1f %10.1f\n", "RBT + hash",
+            seconds(begin, end) * 1e9 / BENCH_OPS,
+            100.0 * hash.hits / (hash.hits + hash.misses));
+
+    printf("\n");
+    RBT_hash_free(&hash);
+    free(requests);
+    free(capacities);
+    free(nodes);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Parallel Build and Validation                                            //
+//////////////////////////////////////////////////////////////////////////////
+// Compare building a tree by repeated RBT_add with RBT_parallel_build, and
+// validating it with RBT_parallel_rep_ok, for increasing numbers of threads.
+// (Speedups are bounded by the number of processors.)
+void parallel_bench() {
+    struct RBT *blocks = malloc(BENCH_NODES * sizeof(struct RBT));
+    RBT *nodes = malloc(BENCH_NODES * sizeof(RBT));
+    if (blocks == NULL || nodes == NULL) {
+        printf("parallel_bench: out of memory\n");
+        free(blocks);
+        free(nodes);
+        return;
+    }
+    printf("Parallel build and validation (%d nodes, %ld processors)\n",
+            BENCH_NODES, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  %-12s %10s %10s\n", "threads", "build s", "rep_ok s");
+
+    srand(1);
+    clock_t begin = clock();
+    RBT tree = NULL;
+    for (unsigned int j = 0; j < BENCH_NODES; j++) {
+        tree = RBT_add(tree, &blocks[j], rand() % (1 << 24));
+    }
+    clock_t end = clock();
+    printf("  %-12s %10.3f %10s\n", "RBT_add", seconds(begin, end), "-");
+
+    unsigned int threads[] = {1, 2, 4, 8};
+    for (int t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        srand(1);
+        for (unsigned int j = 0; j < BENCH_NODES; j++) {
+            blocks[j].capacity = rand() % (1 << 24);
+            nodes[j] = &blocks[j];
+        }
+        // wall-clock time, since clock() sums the time of every thread
+        double start = wall_seconds();
+        tree = RBT_parallel_build(nodes, BENCH_NODES, threads[t]);
+        double built = wall_seconds();
+        RBT_parallel_rep_ok(tree, threads[t]);
+        double checked = wall_seconds();
+        printf("  %-12u %10.3f %10.3f\n", threads[t], built - start, checked - built);
+    }
+
+    printf("\n");
+    free(nodes);
+    free(blocks);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// NUMA Arenas                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// A thread of the NUMA benchmark, pinned to one processor.
+typedef struct numa_worker {
+    RBT_numa *numa;      // allocator (NULL for malloc)
+    int cpu;             // processor to run on
+    size_t checked;      // number of allocations whose page node was checked
+    size_t local;        // number of those on the thread's node
+    double seconds;      // time taken
+} numa_worker;
+
+// helper: Returns the NUMA node of the page containing `ptr`, or -1 if it
+// cannot be determined.
+int numa_page_node(void *ptr) {
+    #ifdef SYS_move_pages
+    void *page = (void *)((size_t)ptr & ~(size_t)(sysconf(_SC_PAGESIZE) - 1));
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1, &page, NULL, &status, 0) == 0 && status >= 0) {
+        return status;
+    }
+    #endif
+    return -1;
+}
+
+// helper: Allocates and frees random sizes, checking the node of every 16th
+// allocation's memory.
+void *numa_worker_run(void *arg) {
+    numa_worker *worker = arg;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    int node = RBT_numa_current_node();
+    unsigned int seed = worker->cpu;
+    void *live[BENCH_NUMA_LIVE] = {NULL};
+
+    double begin = wall_seconds();
+    for (unsigned int j = 0; j < BENCH_NUMA_OPS; j++) {
+        int k = rand_r(&seed) % BENCH_NUMA_LIVE;
+        if (live[k] != NULL) {
+            if (worker->numa == NULL) {
+                free(live[k]);
+            } else {
+                RBT_numa_free(worker->numa, live[k]);
+            }
+            live[k] = NULL;
+            continue;
+        }
+        size_t size = BENCH_MIN_SIZE + rand_r(&seed) % 4096;
+        live[k] = worker->numa == NULL ? malloc(size) : RBT_numa_alloc(worker->numa, size);
+        if (live[k] != NULL && j % 16 == 0) {
+            *(char *)live[k] = 1; // (fault the page in)
+            int page_node = numa_page_node(live[k]);
+            worker->checked += page_node >= 0;
+            worker->local += page_node == node;
+        }
+    }
+    worker->seconds = wall_seconds() - begin;
+    for (int k = 0; k < BENCH_NUMA_LIVE; k++) {
+        if (worker->numa == NULL) {
+            free(live[k]);
+        } else {
+            RBT_numa_free(worker->numa, live[k]);
+        }
+    }
+    return NULL;
+}
+
+// helper: Runs one pinned worker per processor with the given allocator (NULL
+// for malloc) and prints a row of results.
+void numa_run(RBT_numa *numa, const char *name) {
+    int num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    numa_worker *workers = calloc(num_cpus, sizeof(numa_worker));
+    pthread_t *threads = calloc(num_cpus, sizeof(pthread_t));
+    for (int i = 0; i < num_cpus; i++) {
+        workers[i] = (numa_worker){numa, i};
+        pthread_create(&threads[i], NULL, numa_worker_run, &workers[i]);
+    }
+    size_t checked = 0, local = 0;
+    double seconds = 0;
+    for (int i = 0; i < num_cpus; i++) {
+        pthread_join(threads[i], NULL);
+        checked += workers[i].checked;
+        local += workers[i].local;
+        seconds += workers[i].seconds;
+    }
+    printf("  %-12s %10.1f ", name, seconds * 1e9 / num_cpus / BENCH_NUMA_OPS);
+    if (checked == 0) {
+        printf("%14s\n", "-");
+    } else {
+        printf("%13.1f%%\n", 100.0 * local / checked);
+    }
+    free(threads);
+    free(workers);
+}
+
+// Compare malloc with per-node arenas, with one pinned thread per processor,
+// by the share of allocations whose memory is on the thread's node.
+void numa_bench() {
+    RBT_numa numa;
+    if (!RBT_numa_init(&numa, BENCH_NUMA_ARENA, RBT_fit_new(RBT_BEST_FIT))) {
+        printf("numa_bench: out of memory\n");
+        return;
+    }
+    printf("NUMA arenas (%d arenas, %ld threads, %d requests each)\n",
+            numa.num_arenas, sysconf(_SC_NPROCESSORS_ONLN), BENCH_NUMA_OPS);
+    printf("  %-12s %10s %14s\n", "allocator", "ns/op", "local pages");
+    numa_run(NULL, "malloc");
+    numa_run(&numa, "RBT_numa");
+    printf("  %-12s %10s %10s %10s %10s\n", "arena", "node", "bound", "local", "remote");
+    for (int i = 0; i < numa.num_arenas; i++) {
+        RBT_numa_arena *arena = &numa.arenas[i];
+        printf("  %-12d %10d %10s %10zu %10zu\n", i, arena->node,
+                arena->bound ? "yes" : "no", arena->local_allocs, arena->remote_allocs);
+    }
+    printf("\n");
+    RBT_numa_destroy(&numa);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Slab Caches                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// Compare allocating fixed-size objects from a heap with allocating them from
+// a slab cache on the same heap, while other (variable-size) blocks churn. The
+// number of free blocks in the heap's tree at the end is also reported.
+void slab_bench() {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **objects = calloc(BENCH_SLAB_LIVE, sizeof(void *));
+    void **others = calloc(BENCH_SLAB_LIVE, sizeof(void *));
+    if (mem == NULL || objects == NULL || others == NULL) {
+        printf("slab_bench: out of memory\n");
+        free(mem);
+        free(objects);
+        free(others);
+        return;
+    }
+    printf("Slab caches (%d-byte objects, %d live, %d requests)\n",
+            BENCH_SLAB_OBJECT, BENCH_SLAB_LIVE, BENCH_OPS);
+    printf("  %-12s %10s %12s\n", "allocator", "ns/op", "free blocks");
+
+    for (int use_slab = 0; use_slab < 2; use_slab++) {
+        RBT_heap heap;
+        RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        RBT_slab_cache cache;
+        RBT_slab_cache_init(&cache, &heap, BENCH_SLAB_OBJECT);
+        memset(objects, 0, BENCH_SLAB_LIVE * sizeof(void *));
+        memset(others, 0, BENCH_SLAB_LIVE * sizeof(void *));
+
+        srand(1);
+        clock_t begin = clock();
+        for (unsigned int j = 0; j < BENCH_OPS; j++) {
+            int k = rand() % BENCH_SLAB_LIVE;
+            if (j % 8 == 0) { // a variable-size block
+                RBT_heap_free(&heap, others[k]);
+                others[k] = RBT_heap_alloc(&heap, random_size() / 16);
+            } else if (use_slab) {
+                RBT_slab_free(&cache, objects[k]);
+                objects[k] = RBT_slab_alloc(&cache);
+            } else {
+                RBT_heap_free(&heap, objects[k]);
+                objects[k] = RBT_heap_alloc(&heap, BENCH_SLAB_OBJECT);
+            }
+        }
+        clock_t end = clock();
+        RBT_heap_stats stats;
+        RBT_heap_get_stats(&heap, &stats);
+        printf("  %-12s %10.1f %12zu\n", use_slab ? "slab" : "heap",
+                seconds(begin, end) * 1e9 / BENCH_OPS, stats.free_blocks);
+    }
+    printf("\n");
+    free(others);
+    free(objects);
+    free(mem);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Regions                                                                  //
+//////////////////////////////////////////////////////////////////////////////
+// Compare freeing the scratch objects (16-512 bytes) of each request one by
+// one with allocating them from a region which is reset after the request.
+// A set of long-lived blocks keeps the heap fragmented.
+void region_bench() {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **scratch = malloc(BENCH_SCRATCH * sizeof(void *));
+    void **others = calloc(BENCH_SLAB_LIVE, sizeof(void *));
+    if (mem == NULL || scratch == NULL || others == NULL) {
+        printf("region_bench: out of memory\n");
+        free(mem);
+        free(scratch);
+        free(others);
+        return;
+    }
+    printf("Regions (%d requests, %d scratch objects each)\n",
+            BENCH_REQUESTS, BENCH_SCRATCH);
+    printf("  %-12s %10s %12s\n", "allocator", "ns/object", "free blocks");
+
+    for (int use_region = 0; use_region < 2; use_region++) {
+        RBT_heap heap;
+        RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        RBT_region region;
+        RBT_region_init(&region, &heap, 0);
+        memset(others, 0, BENCH_SLAB_LIVE * sizeof(void *));
+
+        srand(1);
+        double elapsed = 0;
+        for (int r = 0; r < BENCH_REQUESTS; r++) {
+            for (int j = 0; j < 16; j++) { // churn the long-lived blocks
+                int k = rand() % BENCH_SLAB_LIVE;
+                RBT_heap_free(&heap, others[k]);
+                others[k] = RBT_heap_alloc(&heap, random_size() / 16);
+            }
+            clock_t begin = clock();
+            for (int j = 0; j < BENCH_SCRATCH; j++) {
+                size_t size = 16 + rand() % 497;
+                scratch[j] = use_region ? RBT_region_alloc(&region, size)
+                                        : RBT_heap_alloc(&heap, size);
+            }
+            if (use_region) {
+                RBT_region_reset(&region);
+            } else {
+                for (int j = 0; j < BENCH_SCRATCH; j++) {
+                    RBT_heap_free(&heap, scratch[j]);
+                }
+            }
+            elapsed += seconds(begin, clock());
+        }
+        RBT_heap_stats stats;
+        RBT_heap_get_stats(&heap, &stats);
+        printf("  %-12s %10.1f %12zu\n", use_region ? "region" : "heap",
+                elapsed * 1e9 / ((double)BENCH_REQUESTS * BENCH_SCRATCH),
+                stats.free_blocks);
+    }
+    printf("\n");
+    free(others);
+    free(scratch);
+    free(mem);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Compaction                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// Fill a heap with relocatable objects, free a random half of them, and
+// compact it. The cost of compaction and the free blocks before and after it
+// are reported.
+void compact_bench() {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    RBT_handle *handles = malloc(BENCH_HANDLES * sizeof(RBT_handle));
+    RBT_heap heap;
+    RBT_handle_table table;
+    if (mem == NULL || handles == NULL ||
+            !RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT)) ||
+            !RBT_handle_table_init(&table, &heap)) {
+        printf("compact_bench: out of memory\n");
+        free(mem);
+        free(handles);
+        return;
+    }
+    srand(1);
+    size_t live = 0;
+    for (int k = 0; k < BENCH_HANDLES; k++) {
+        handles[k] = RBT_handle_alloc(&table, random_size() / 16);
+        live += handles[k] != 0;
+    }
+    for (int k = 0; k < BENCH_HANDLES; k++) {
+        if (rand() % 2 == 0) {
+            RBT_handle_free(&table, handles[k]);
+            live -= handles[k] != 0;
+        }
+    }
+    RBT_heap_flush(&heap);
+    printf("Compaction (%zu live objects)\n", live);
+    printf("  %-12s %12s %14s\n", "", "free blocks", "largest free");
+    RBT_heap_stats stats;
+    RBT_heap_get_stats(&heap, &stats);
+    printf("  %-12s %12zu %14zu\n", "before", stats.free_blocks, stats.largest_free);
+
+    clock_t begin = clock();
+    RBT_handle_compact(&table);
+    clock_t end = clock();
+    RBT_heap_get_stats(&heap, &stats);
+    printf("  %-12s %12zu %14zu\n", "after", stats.free_blocks, stats.largest_free);
+    printf("  compaction: %.1f ms (%.1f ns per object)\n\n",
+            seconds(begin, end) * 1e3, seconds(begin, end) * 1e9 / live);
+    RBT_handle_table_destroy(&table);
+    free(handles);
+    free(mem);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Split Headers                                                            //
+//////////////////////////////////////////////////////////////////////////////
+// Churn small (32-64 byte) objects on heaps with full and split headers,
+// reporting the heap's footprint (up to the highest block in use) per live
+// object at the end.
+void split_bench() {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **objects = calloc(BENCH_SLAB_LIVE, sizeof(void *));
+    if (mem == NULL || objects == NULL) {
+        printf("split_bench: out of memory\n");
+        free(mem);
+        free(objects);
+        return;
+    }
+    printf("Split headers (32-64 byte objects, %d live, %d requests)\n",
+            BENCH_SLAB_LIVE, BENCH_OPS);
+    printf("  %-12s %10s %14s\n", "headers", "ns/op", "bytes/object");
+    for (int split = 0; split < 2; split++) {
+        RBT_heap heap;
+        RBT_fit fit = RBT_fit_new(RBT_BEST_FIT);
+        if (split) {
+            RBT_heap_init_split(&heap, mem, BENCH_HEAP_SIZE, fit);
+        } else {
+            RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, fit);
+        }
+        memset(objects, 0, BENCH_SLAB_LIVE * sizeof(void *));
+
+        srand(1);
+        clock_t begin = clock();
+        for (unsigned int j = 0; j < BENCH_OPS; j++) {
+            int k = j < BENCH_SLAB_LIVE ? j : rand() % BENCH_SLAB_LIVE;
+            RBT_heap_free(&heap, objects[k]);
+            objects[k] = RBT_heap_alloc(&heap, 32 + rand() % 33);
+        }
+        clock_t end = clock();
+        char *high_water = heap.start;
+        for (int k = 0; k < BENCH_SLAB_LIVE; k++) {
+            char *block_end = (char *)objects[k] + RBT_heap_usable_size(&heap, objects[k]);
+            if (block_end > high_water) {
+                high_water = block_end;
+            }
+        }
+        printf("  %-12s %10.1f %14.1f\n", split ? "split (8)" : "full (32)",
+                seconds(begin, end) * 1e9 / BENCH_OPS,
+                (double)(high_water - heap.start) / BENCH_SLAB_LIVE);
+    }
+    printf("\n");
+    free(objects);
+    free(mem);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Allocation Traces                                                        //
+//////////////////////////////////////////////////////////////////////////////
+// An allocation trace is a sequence of requests, each of which either
+// allocates `size` bytes for the object `id` or frees the object `id`.
+// In a trace file, each line is one request: "a <id> <size>" or "f <id>".
+typedef struct trace_op {
+    bool alloc;        // allocate (true) or free (false)
+    unsigned int id;   // object identifier
+    unsigned int size; // number of bytes to allocate
+} trace_op;
+
+typedef struct trace {
+    trace_op *ops;       // requests
+    size_t len;          // number of requests
+    unsigned int ids;    // (exclusive) upper bound of the object identifiers
+} trace;
+
+// helper: Returns a random object size, mostly small with a long tail.
+unsigned int trace_size() {
+    int r = rand() % 100;
+    if (r < 70) {
+        return 16 + rand() % 240;
+    }
+    if (r < 95) {
+        return 256 + rand() % 3840;
+    }
+    return 4096 + rand() % 61440;
+}
+
+// trace_generate returns a random trace of BENCH_TRACE_OPS requests which
+// keeps about BENCH_TRACE_LIVE objects alive at a time, freeing them in random
+// order.
+trace trace_generate() {
+    trace t = {malloc(BENCH_TRACE_OPS * sizeof(trace_op)), 0, 0};
+    unsigned int *live = malloc(BENCH_TRACE_LIVE * sizeof(unsigned int));
+    size_t num_live = 0;
+    srand(1);
+    while (t.len < BENCH_TRACE_OPS) {
+        bool alloc = num_live == 0 ||
+            (num_live < BENCH_TRACE_LIVE && rand() % 5 < 3);
+        if (alloc) {
+            live[num_live++] = t.ids;
+            t.ops[t.len++] = (trace_op){true, t.ids++, trace_size()};
+        } else {
+            size_t i = rand() % num_live;
+            t.ops[t.len++] = (trace_op){false, live[i], 0};
+            live[i] = live[--num_live];
+        }
+    }
+    free(live);
+    return t;
+}
+
+// trace_generate_churn returns a trace like trace_generate, except that half
+// of the allocations request the size of the most recently freed object (as
+// when temporary buffers are freed and reallocated).
+trace trace_generate_churn() {
+    trace t = {malloc(BENCH_TRACE_OPS * sizeof(trace_op)), 0, 0};
+    unsigned int *live = malloc(BENCH_TRACE_LIVE * sizeof(unsigned int));
+    unsigned int *sizes = malloc(BENCH_TRACE_OPS * sizeof(unsigned int));
+    size_t num_live = 0;
+    unsigned int last_freed = 0;
+    srand(1);
+    while (t.len < BENCH_TRACE_OPS) {
+        bool alloc = num_live == 0 ||
+            (num_live < BENCH_TRACE_LIVE && rand() % 5 < 3);
+        if (alloc) {
+            unsigned int size = last_freed != 0 && rand() % 2 == 0 ?
+                    last_freed : trace_size();
+            sizes[t.ids] = size;
+            live[num_live++] = t.ids;
+            t.ops[t.len++] = (trace_op){true, t.ids++, size};
+        } else {
+            size_t i = rand() % num_live;
+            last_freed = sizes[live[i]];
+            t.ops[t.len++] = (trace_op){false, live[i], 0};
+            live[i] = live[--num_live];
+        }
+    }
+    free(sizes);
+    free(live);
+    return t;
+}
+
+// trace_read returns the trace in the file at `path`. The returned trace has
+// no requests if the file cannot be read.
+trace trace_read(const char *path) {
+    trace t = {NULL, 0, 0};
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("trace_read: cannot open %s\n", path);
+        return t;
+    }
+    size_t cap = 0;
+    char kind;
+    unsigned int id;
+    while (fscanf(file, " %c %u", &kind, &id) == 2) {
+        unsigned int size = 0;
+        if (kind == 'a' && fscanf(file, "%u", &size) != 1) {
+            break;
+        }
+        if (t.len == cap) {
+            cap = cap == 0 ? 1024 : 2 * cap;
+            t.ops = realloc(t.ops, cap * sizeof(trace_op));
+        }
+        t.ops[t.len++] = (trace_op){kind == 'a', id, size};
+        if (id >= t.ids) {
+            t.ids = id + 1;
+        }
+    }
+    fclose(file);
+    return t;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Placement Policies                                                       //
+//////////////////////////////////////////////////////////////////////////////
+// Replay a trace on a heap with each placement policy, measuring throughput
+// and fragmentation:
+//   - failed:     requests that could not be satisfied
+//   - high water: the highest address in use (relative to the heap start)
+//   - frag:       the share of the heap below the high water mark that is not
+//                 in use at the end of the trace
+void fit_bench(trace t) {
+    // the last good fit prefers capacities with duplicates
+    RBT_fit_policy policies[] = {RBT_BEST_FIT, RBT_GOOD_FIT, RBT_FIRST_FIT,
+                                 RBT_NEXT_FIT, RBT_WORST_FIT, RBT_GOOD_FIT};
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **ptrs = calloc(t.ids, sizeof(void *));
+    if (mem == NULL || ptrs == NULL) {
+        printf("fit_bench: out of memory\n");
+        free(mem);
+        free(ptrs);
+        return;
+    }
+
+    printf("Placement policies (%zu requests, %d MiB heap)\n", t.len,
+            BENCH_HEAP_SIZE >> 20);
+    printf("  %-12s %10s %10s %14s %10s\n",
+            "policy", "ns/op", "failed", "high water", "frag");
+    for (int i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        RBT_heap heap;
+        RBT_fit fit = RBT_fit_new(policies[i]);
+        fit.percent = 5;
+        fit.duplicates = i == 5;
+        RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, fit);
+        memset(ptrs, 0, t.ids * sizeof(void *));
+
+        size_t failed = 0;
+        size_t high_water = 0;
+        clock_t begin = clock();
+        for (size_t j = 0; j < t.len; j++) {
+            trace_op op = t.ops[j];
+            if (!op.alloc) {
+                RBT_heap_free(&heap, ptrs[op.id]);
+                ptrs[op.id] = NULL;
+                continue;
+            }
+            char *ptr = RBT_heap_alloc(&heap, op.size);
+            if (ptr == NULL) {
+                failed++;
+                continue;
+            }
+            ptrs[op.id] = ptr;
+            if ((size_t)(ptr + op.size - heap.start) > high_water) {
+                high_water = ptr + op.size - heap.start;
+            }
+        }
+        clock_t end = clock();
+
+        RBT_heap_stats stats;
+        RBT_heap_get_stats(&heap, &stats);
+        char name[32];
+        snprintf(name, sizeof(name), fit.duplicates ? "%s+dup" : "%s",
+                RBT_fit_name(fit.policy));
+        printf("  %-12s %10.1f %10zu %10.1f MiB %9.2f%%\n",
+                name, seconds(begin, end) * 1e9 / t.len,
+                failed, high_water / 1048576.0,
+                100.0 - 100.0 * stats.used_bytes / high_water);
+    }
+    printf("\n");
+    free(ptrs);
+    free(mem);
+}
+
+// The trace replayed by trace benchmarks (generated unless given with -t).
+trace bench_trace;
+
+// helper: Runs fit_bench on bench_trace.
+void fit_trace_bench() {
+    fit_bench(bench_trace);
+}
+
+// bin_bench replays trace `t` (named `name`) on best-fit heaps with and
+// without a staging bin for freed blocks.
+void bin_bench(trace t, const char *name) {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **ptrs = calloc(t.ids, sizeof(void *));
+    if (mem == NULL || ptrs == NULL) {
+        printf("bin_bench: out of memory\n");
+        free(mem);
+        free(ptrs);
+        return;
+    }
+
+    printf("Staging bin (%s trace, %zu requests)\n", name, t.len);
+    printf("  %-12s %10s %10s %10s\n", "bin", "ns/op", "hit %", "failed");
+    size_t limits[] = {0, RBT_HEAP_BIN_SIZE};
+    for (int i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        RBT_heap heap;
+        RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        heap.bin_limit = limits[i];
+        memset(ptrs, 0, t.ids * sizeof(void *));
+
+        size_t allocs = 0;
+        size_t failed = 0;
+        clock_t begin = clock();
+        for (size_t j = 0; j < t.len; j++) {
+            trace_op op = t.ops[j];
+            if (!op.alloc) {
+                RBT_heap_free(&heap, ptrs[op.id]);
+                ptrs[op.id] = NULL;
+                continue;
+            }
+            allocs++;
+            ptrs[op.id] = RBT_heap_alloc(&heap, op.size);
+            failed += ptrs[op.id] == NULL;
+        }
+        clock_t end = clock();
+        char limit[16];
+        snprintf(limit, sizeof(limit), "%zu blocks", limits[i]);
+        printf("  %-12s %10.1f %10.1f %10zu\n", limit,
+                seconds(begin, end) * 1e9 / t.len,
+                100.0 * heap.bin_hits / allocs, failed);
+    }
+    printf("\n");
+    free(ptrs);
+    free(mem);
+}
+
+// helper: Runs bin_bench on bench_trace and on a generated trace with churn.
+void bin_trace_bench() {
+    bin_bench(bench_trace, "default");
+    trace churn = trace_generate_churn();
+    bin_bench(churn, "churn");
+    free(churn.ops);
+}
+
+// class_bench replays trace `t` (named `name`) on best-fit heaps with size
+// classes of increasing granularity, measuring:
+//   - keys:   distinct capacities in the RBT at the end of the trace
+//   - height: height of the RBT at the end of the trace
+//   - hit %:  allocations served by the staging bin
+//   - waste:  bytes added to the requests by rounding
+//   - frag:   as in fit_bench
+void class_bench(trace t, const char *name) {
+    void *mem = malloc(BENCH_HEAP_SIZE);
+    void **ptrs = calloc(t.ids, sizeof(void *));
+    if (mem == NULL || ptrs == NULL) {
+        printf("class_bench: out of memory\n");
+        free(mem);
+        free(ptrs);
+        return;
+    }
+
+    printf("Size classes (%s trace, %zu requests)\n", name, t.len);
+    printf("  %-12s %10s %8s %8s %8s %8s %8s\n",
+            "classes", "ns/op", "keys", "height", "hit %", "waste", "frag");
+    unsigned int class_bits[] = {0, 4, 3, 2};
+    for (int i = 0; i < sizeof(class_bits) / sizeof(class_bits[0]); i++) {
+        RBT_heap heap;
+        RBT_heap_init(&heap, mem, BENCH_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        heap.class_bits = class_bits[i];
+        memset(ptrs, 0, t.ids * sizeof(void *));
+
+        size_t allocs = 0;
+        size_t requested = 0;
+        size_t rounded = 0;
+        size_t high_water = 0;
+        clock_t begin = clock();
+        for (size_t j = 0; j < t.len; j++) {
+            trace_op op = t.ops[j];
+            if (!op.alloc) {
+                RBT_heap_free(&heap, ptrs[op.id]);
+                ptrs[op.id] = NULL;
+                continue;
+            }
+            char *ptr = RBT_heap_alloc(&heap, op.size);
+            ptrs[op.id] = ptr;
+            if (ptr == NULL) {
+                continue;
+            }
+            allocs++;
+            requested += op.size;
+            rounded += RBT_heap_class(&heap, op.size);
+            if ((size_t)(ptr + op.size - heap.start) > high_water) {
+                high_water = ptr + op.size - heap.start;
+            }
+        }
+        clock_t end = clock();
+
+        RBT_heap_flush(&heap);
+        size_t keys = 0;
+        RBT_cursor cursor;
+        for (RBT node = RBT_cursor_first(&cursor, heap.root); node != NULL;
+                node = RBT_cursor_next(&cursor)) {
+            keys++;
+        }
+        RBT_heap_stats stats;
+        RBT_heap_get_stats(&heap, &stats);
+        char classes[16];
+        snprintf(classes, sizeof(classes), class_bits[i] == 0 ? "none" : "%u/doubling",
+                1u << class_bits[i]);
+        printf("  %-12s %10.1f %8zu %8d %8.1f %7.2f%% %7.2f%%\n", classes,
+                seconds(begin, end) * 1e9 / t.len, keys, RBT_height(heap.root),
+                100.0 * heap.bin_hits / allocs,
+                100.0 * (rounded - requested) / requested,
+                100.0 - 100.0 * stats.used_bytes / high_water);
+    }
+    printf("\n");
+    free(ptrs);
+    free(mem);
+}
+
+// helper: Runs class_bench on bench_trace and on a generated trace with churn.
+void class_trace_bench() {
+    class_bench(bench_trace, "default");
+    trace churn = trace_generate_churn();
+    class_bench(churn, "churn");
+    free(churn.ops);
+}
+
+// Benchmarks, by name.
+struct {
+    const char *name;
+    void (*run)();
+} benchmarks[] = {
+    {"good_fit", &good_fit_bench},
+    {"index", &index_bench},
+    {"snapshot", &snapshot_bench},
+    {"mru", &mru_bench},
+    {"exact", &exact_bench},
+    {"parallel", &parallel_bench},
+    {"numa", &numa_bench},
+    {"slab", &slab_bench},
+    {"region", &region_bench},
+    {"compact", &compact_bench},
+    {"split", &split_bench},
+    {"fit", &fit_trace_bench},
+    {"bin", &bin_trace_bench},
+    {"class", &class_trace_bench},
+};
+
+// Run benchmarks.
+//   usage: rbt_bench [-t trace_file] [benchmark ...]
+// If no benchmarks are named, then every benchmark is run. If a trace file is
+// given, then its allocation trace is replayed instead of a generated one.
+int main(int argc, char **argv) {
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+        bench_trace = trace_read(argv[2]);
+        first = 3;
+    } else {
+        bench_trace = trace_generate();
+    }
+
+    int num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for (int i = 0; i < num_benchmarks; i++) {
+        bool selected = first == argc;
+        for (int j = first; j < argc; j++) {
+            selected |= strcmp(argv[j], benchmarks[i].name) == 0;
+        }
+        if (selected) {
+            benchmarks[i].run();
+        }
+    }
+
+    free(bench_trace.ops);
+    return 0;
+}
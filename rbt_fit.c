@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_fit.c                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_fit.c contains implementations of the functions declared in rbt_fit.h.
+#include "rbt_fit.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+RBT_fit RBT_fit_new(RBT_fit_policy policy) {
+    RBT_fit fit = {0};
+    fit.policy = policy;
+    return fit;
+}
+
+const char *RBT_fit_name(RBT_fit_policy policy) {
+    switch (policy) {
+        case RBT_BEST_FIT: return "best fit";
+        case RBT_GOOD_FIT: return "good fit";
+        case RBT_FIRST_FIT: return "first fit";
+        case RBT_NEXT_FIT: return "next fit";
+        case RBT_WORST_FIT: return "worst fit";
+    }
+    return "unknown";
+}
+
+// helper: Returns the lowest-addressed node (including nodes in linked lists)
+// whose capacity is at least `capacity`, or NULL if there is no such node.
+RBT RBT_lowest_at_least(RBT root, unsigned int capacity) {
+    RBT lowest = NULL;
+    RBT_cursor cursor;
+    RBT_cursor_seek_at_least(&cursor, root, capacity);
+    for (RBT node = cursor.block; node != NULL; node = RBT_cursor_next_block(&cursor)) {
+        if (lowest == NULL || node < lowest) {
+            lowest = node;
+        }
+    }
+    return lowest;
+}
+
+// helper: Returns the node with the largest capacity, or NULL if `root` is
+// empty.
+RBT RBT_largest(RBT root) {
+    if (root == NULL) {
+        return NULL;
+    }
+    while (root->right != NULL) {
+        root = root->right;
+    }
+    return root;
+}
+
+// helper: Returns the smallest tree node with a capacity in
+// [capacity, capacity + slack] and more than one node, among the first
+// RBT_FIT_DUPLICATE_SCAN tree nodes of at least `capacity`, or NULL if there is
+// no such node.
+RBT RBT_duplicate_fit(RBT root, unsigned int capacity, unsigned int slack) {
+    RBT_cursor cursor;
+    RBT node = RBT_cursor_seek_at_least(&cursor, root, capacity);
+    for (int i = 0; i < RBT_FIT_DUPLICATE_SCAN && node != NULL &&
+            node->capacity - capacity <= slack; i++) {
+        if (RBT_count(node) > 1) {
+            return node;
+        }
+        node = RBT_cursor_next(&cursor);
+    }
+    return NULL;
+}
+
+RBT RBT_remove_fit(RBT root, RBT_fit *fit, unsigned int capacity, RBT *removed) {
+    if (removed == NULL) {
+        return root;
+    }
+
+    switch (fit->policy) {
+        case RBT_BEST_FIT:
+            return RBT_remove_at_least(root, capacity, removed);
+        case RBT_GOOD_FIT: {
+            unsigned int slack = RBT_percent_slack(capacity, fit->percent);
+            if (fit->slack > slack) {
+                slack = fit->slack;
+            }
+            RBT head = fit->duplicates ? RBT_duplicate_fit(root, capacity, slack) : NULL;
+            if (head != NULL) { // take a node from its linked list
+                return RBT_remove_at_least(root, head->capacity, removed);
+            }
+            return RBT_remove_good_fit(root, capacity, slack, removed);
+        }
+        case RBT_FIRST_FIT:
+            return RBT_remove_node(root,
+                    RBT_lowest_at_least(root, capacity), removed);
+        case RBT_NEXT_FIT:
+            if (fit->rover > capacity) {
+                root = RBT_remove_at_least(root, fit->rover, removed);
+            } else {
+                *removed = NULL;
+            }
+            if (*removed == NULL) { // wrap around
+                root = RBT_remove_at_least(root, capacity, removed);
+            }
+            if (*removed != NULL) {
+                fit->rover = (*removed)->capacity;
+            }
+            return root;
+        case RBT_WORST_FIT: {
+            RBT largest = RBT_largest(root);
+            if (largest == NULL || largest->capacity < capacity) {
+                *removed = NULL;
+                return root;
+            }
+            return RBT_remove_at_least(root, largest->capacity, removed);
+        }
+    }
+    *removed = NULL;
+    return root;
+}
@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_fit.h                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_fit.h contains declarations of placement policies over an RBT of free
+// blocks. A policy decides which block satisfies a request, which trades off
+// search time against fragmentation. All policies share the same entry point
+// (RBT_remove_fit) so that the policy can be chosen at runtime.
+
+#ifndef RBT_FIT_H
+#define RBT_FIT_H
+
+#include <stdbool.h>
+
+#include "rbt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of capacities RBT_GOOD_FIT looks at for duplicates (see below).
+#define RBT_FIT_DUPLICATE_SCAN 8
+
+// Placement policies.
+typedef enum RBT_fit_policy {
+    RBT_BEST_FIT,  // the smallest block that is large enough
+    RBT_GOOD_FIT,  // the first block found within a slack of the request
+    RBT_FIRST_FIT, // the lowest-addressed block that is large enough
+    RBT_NEXT_FIT,  // the smallest block at least as large as the rover
+    RBT_WORST_FIT, // the largest block
+} RBT_fit_policy;
+
+// Placement policy and its state.
+typedef struct RBT_fit {
+    RBT_fit_policy policy;
+    unsigned int slack;   // RBT_GOOD_FIT: absolute slack (in bytes)
+    unsigned int percent; // RBT_GOOD_FIT: slack relative to the request
+    bool duplicates;      // RBT_GOOD_FIT: prefer capacities with duplicates
+    unsigned int rover;   // RBT_NEXT_FIT: capacity of the last block removed
+} RBT_fit;
+
+// RBT_fit_new returns a policy of the given kind with all options and state
+// set to 0. For RBT_GOOD_FIT, set `slack` and/or `percent` afterwards (the
+// larger of the two resulting slacks is used).
+RBT_fit RBT_fit_new(RBT_fit_policy policy);
+
+// RBT_fit_name returns a human-readable name for the given policy.
+const char *RBT_fit_name(RBT_fit_policy policy);
+
+// RBT_remove_fit removes a node whose capacity is at least that requested,
+// chosen according to `fit`, and stores a pointer to it in `removed`. The
+// returned RBT points to the new root. If no such node exists, then the
+// original root is returned and a NULL pointer is stored in `removed`. If
+// `removed` is NULL then the original root is returned (without modifying the
+// tree).
+//
+// Costs (in addition to the O(log n) removal):
+//   - RBT_BEST_FIT, RBT_GOOD_FIT, RBT_NEXT_FIT: none.
+//   - RBT_WORST_FIT: an O(log n) walk to the largest node.
+//   - RBT_FIRST_FIT: a walk of every node that is large enough, since the tree
+//     is ordered by capacity rather than by address.
+//
+// With `duplicates` set, RBT_GOOD_FIT takes the smallest capacity within the
+// slack that has more than one node (see RBT_count), looking at up to
+// RBT_FIT_DUPLICATE_SCAN capacities, since removing a node from a linked list
+// does not restructure the tree. It falls back to the usual good fit.
+//
+// RBT_NEXT_FIT continues from the capacity of the previous block it removed
+// (the "rover") and wraps around to the best fit once no larger block
+// remains, spreading requests over the range of capacities.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = RBT_remove_fit(tree, ..., ..., ...);
+RBT RBT_remove_fit(RBT root, RBT_fit *fit, unsigned int capacity, RBT *removed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RBT_FIT_H */
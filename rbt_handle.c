@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_handle.c                                                             //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_handle.c contains implementations of the functions declared in
+// rbt_handle.h.
+#include "rbt_handle.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#define RBT_HANDLE_ERROR "\033[31;1mError: \033[0m"
+
+// helper: Doubles the number of slots of `table`, pushing the new handles
+// onto the unused stack (lowest on top). Returns false if out of memory.
+bool RBT_handle_grow(RBT_handle_table *table) {
+    size_t num_slots = 2 * table->num_slots;
+    void **objects = realloc(table->objects, num_slots * sizeof(void *));
+    if (objects == NULL) {
+        return false;
+    }
+    table->objects = objects;
+    RBT_handle *unused = realloc(table->unused, num_slots * sizeof(RBT_handle));
+    if (unused == NULL) {
+        return false;
+    }
+    table->unused = unused;
+    for (size_t i = num_slots; i-- > table->num_slots; ) {
+        objects[i] = NULL;
+        unused[table->num_unused++] = i;
+    }
+    table->num_slots = num_slots;
+    return true;
+}
+
+bool RBT_handle_table_init(RBT_handle_table *table, RBT_heap *heap) {
+    table->heap = heap;
+    table->objects = calloc(RBT_HANDLE_MIN_SLOTS, sizeof(void *));
+    table->unused = malloc(RBT_HANDLE_MIN_SLOTS * sizeof(RBT_handle));
+    if (table->objects == NULL || table->unused == NULL) {
+        free(table->objects);
+        free(table->unused);
+        return false;
+    }
+    // slot 0 is never used, so that 0 is not a valid handle
+    table->num_slots = RBT_HANDLE_MIN_SLOTS;
+    table->num_unused = 0;
+    for (size_t i = RBT_HANDLE_MIN_SLOTS; i-- > 1; ) {
+        table->unused[table->num_unused++] = i;
+    }
+    table->count = 0;
+    return true;
+}
+
+void RBT_handle_table_destroy(RBT_handle_table *table) {
+    for (size_t i = 1; i < table->num_slots; i++) {
+        RBT_heap_free(table->heap, table->objects[i]);
+    }
+    free(table->objects);
+    free(table->unused);
+    table->objects = NULL;
+    table->unused = NULL;
+    table->num_slots = 0;
+    table->num_unused = 0;
+    table->count = 0;
+}
+
+RBT_handle RBT_handle_alloc(RBT_handle_table *table, size_t size) {
+    if (table->num_unused == 0 && !RBT_handle_grow(table)) {
+        return 0;
+    }
+    void *ptr = RBT_heap_alloc(table->heap, size);
+    if (ptr == NULL) {
+        return 0;
+    }
+    RBT_handle handle = table->unused[--table->num_unused];
+    table->objects[handle] = ptr;
+    table->count++;
+    return handle;
+}
+
+void RBT_handle_free(RBT_handle_table *table, RBT_handle handle) {
+    if (handle == 0) {
+        return;
+    }
+    if (handle >= table->num_slots || table->objects[handle] == NULL) {
+        printf(RBT_HANDLE_ERROR "handle %u is not in use\n", handle);
+        raise(SIGABRT);
+    }
+    RBT_heap_free(table->heap, table->objects[handle]);
+    table->objects[handle] = NULL;
+    table->unused[table->num_unused++] = handle;
+    table->count--;
+}
+
+void *RBT_handle_get(RBT_handle_table *table, RBT_handle handle) {
+    return table->objects[handle];
+}
+
+bool RBT_handle_compact(RBT_handle_table *table) {
+    return RBT_heap_compact(table->heap, table->objects, table->num_slots);
+}
@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_handle.h                                                             //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_handle.h contains declarations of functions for relocatable objects,
+// allocated from a heap (see rbt_heap.h) and referred to by handles.
+//
+// A handle is an index into a table holding the current address of its
+// object, so the table may move every object (see RBT_handle_compact) to
+// undo fragmentation: a long-lived heap whose free space is split into many
+// small blocks can no longer serve large requests, even when the total free
+// space would suffice. Blocks allocated from the heap directly are never moved
+// (they are "pinned").
+//
+// Addresses returned by RBT_handle_get are only valid until the next
+// compaction.
+
+#ifndef RBT_HANDLE_H
+#define RBT_HANDLE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rbt_heap.h"
+
+#define RBT_HANDLE_MIN_SLOTS 16 // initial number of slots in a handle table
+
+// Handle of a relocatable object (0 is never a valid handle).
+typedef unsigned int RBT_handle;
+
+// Handle table data type.
+typedef struct RBT_handle_table {
+    RBT_heap *heap;       // where objects are allocated
+    void **objects;       // address of each handle's object (NULL if unused)
+    RBT_handle *unused;   // stack of unused handles
+    size_t num_slots;     // number of slots in `objects` (and `unused`)
+    size_t num_unused;    // number of handles in `unused`
+    size_t count;         // number of objects
+} RBT_handle_table;
+
+// RBT_handle_table_init initializes `table` to allocate objects from `heap`.
+// Returns false if out of memory.
+bool RBT_handle_table_init(RBT_handle_table *table, RBT_heap *heap);
+
+// RBT_handle_table_destroy frees every object of `table`, and the table.
+void RBT_handle_table_destroy(RBT_handle_table *table);
+
+// RBT_handle_alloc allocates an object of `size` bytes and returns its
+// handle, or 0 if out of memory.
+RBT_handle RBT_handle_alloc(RBT_handle_table *table, size_t size);
+
+// RBT_handle_free frees the object of `handle`. Does nothing if `handle` is 0.
+// If `handle` is not in use, raises SIGABRT.
+void RBT_handle_free(RBT_handle_table *table, RBT_handle handle);
+
+// RBT_handle_get returns the current address of the object of `handle`.
+void *RBT_handle_get(RBT_handle_table *table, RBT_handle handle);
+
+// RBT_handle_compact slides every object of `table` toward the start of the
+// heap (see RBT_heap_compact), leaving a single free block after the last
+// object and after each block allocated from the heap directly. Returns false
+// if out of memory.
+bool RBT_handle_compact(RBT_handle_table *table);
+
+#endif /* RBT_HANDLE_H */
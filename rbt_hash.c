@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_hash.c                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_hash.c contains implementations of the functions declared in
+// rbt_hash.h.
+#include "rbt_hash.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// helper: Returns the home slot of `capacity` (Fibonacci hashing, which
+// spreads the multiples of the alignment that capacities tend to be).
+size_t RBT_hash_home(RBT_hash *hash, unsigned int capacity) {
+    return (size_t)((capacity * 0x9E3779B97F4A7C15ull) >> 32) & hash->mask;
+}
+
+// helper: Returns the slot holding `capacity`, or the empty slot where it
+// would be inserted.
+size_t RBT_hash_slot(RBT_hash *hash, unsigned int capacity) {
+    size_t i = RBT_hash_home(hash, capacity);
+    while (hash->slots[i] != NULL && hash->slots[i]->capacity != capacity) {
+        i = (i + 1) & hash->mask;
+    }
+    return i;
+}
+
+// helper: Doubles the number of slots. Returns false if memory for them
+// cannot be allocated.
+bool RBT_hash_grow(RBT_hash *hash) {
+    RBT *old_slots = hash->slots;
+    size_t old_mask = hash->mask;
+    RBT *slots = calloc(2 * (old_mask + 1), sizeof(RBT));
+    if (slots == NULL) {
+        return false;
+    }
+    hash->slots = slots;
+    hash->mask = 2 * old_mask + 1;
+    for (size_t i = 0; i <= old_mask; i++) {
+        if (old_slots[i] != NULL) {
+            hash->slots[RBT_hash_slot(hash, old_slots[i]->capacity)] = old_slots[i];
+        }
+    }
+    free(old_slots);
+    return true;
+}
+
+// helper: Empties slot `i`, moving later entries of its probe sequence back
+// so that no lookup stops early (backward-shift deletion).
+void RBT_hash_erase(RBT_hash *hash, size_t i) {
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & hash->mask;
+        RBT node = hash->slots[j];
+        if (node == NULL) {
+            break;
+        }
+        // `node` may move to slot i unless its home is cyclically in (i, j]
+        size_t home = RBT_hash_home(hash, node->capacity);
+        if (((j - home) & hash->mask) >= ((j - i) & hash->mask)) {
+            hash->slots[i] = node;
+            i = j;
+        }
+    }
+    hash->slots[i] = NULL;
+    hash->size--;
+}
+
+bool RBT_hash_init(RBT_hash *hash) {
+    hash->root = NULL;
+    hash->slots = calloc(RBT_HASH_MIN_SLOTS, sizeof(RBT));
+    hash->mask = RBT_HASH_MIN_SLOTS - 1;
+    hash->size = 0;
+    hash->hits = 0;
+    hash->misses = 0;
+    return hash->slots != NULL;
+}
+
+void RBT_hash_free(RBT_hash *hash) {
+    free(hash->slots);
+    hash->slots = NULL;
+}
+
+RBT RBT_hash_find(RBT_hash *hash, unsigned int capacity) {
+    return hash->slots[RBT_hash_slot(hash, capacity)];
+}
+
+bool RBT_hash_add(RBT_hash *hash, RBT node, unsigned int capacity) {
+    if (node == NULL) {
+        return true;
+    }
+    size_t i = RBT_hash_slot(hash, capacity);
+    if (hash->slots[i] != NULL) {
+        hash->hits++;
+        RBT_add_duplicate(hash->slots[i], node);
+        return true;
+    }
+    hash->misses++;
+    if (2 * (hash->size + 1) > hash->mask + 1) {
+        if (!RBT_hash_grow(hash)) {
+            return false;
+        }
+        i = RBT_hash_slot(hash, capacity);
+    }
+    hash->root = RBT_add(hash->root, node, capacity);
+    hash->slots[i] = node;
+    hash->size++;
+    return true;
+}
+
+RBT RBT_hash_remove_at_least(RBT_hash *hash, unsigned int capacity) {
+    RBT removed;
+    size_t i = RBT_hash_slot(hash, capacity);
+    RBT head = hash->slots[i];
+    if (head != NULL) {
+        hash->hits++;
+        removed = RBT_remove_duplicate(head);
+        if (removed != NULL) {
+            return removed;
+        }
+        hash->root = RBT_remove_node(hash->root, head, &removed);
+        RBT_hash_erase(hash, i);
+        return removed;
+    }
+    hash->misses++;
+    hash->root = RBT_remove_at_least(hash->root, capacity, &removed);
+    if (removed != NULL) {
+        // the tree node is only removed once its list is empty
+        i = RBT_hash_slot(hash, removed->capacity);
+        if (hash->slots[i] == removed) {
+            RBT_hash_erase(hash, i);
+        }
+    }
+    return removed;
+}
+
+RBT RBT_hash_remove_node(RBT_hash *hash, RBT node) {
+    if (node == NULL) {
+        return NULL;
+    }
+    RBT next = node->next;
+    RBT removed;
+    hash->root = RBT_remove_node(hash->root, node, &removed);
+    size_t i = RBT_hash_slot(hash, node->capacity);
+    if (removed != NULL && hash->slots[i] == removed) {
+        if (next != NULL) { // the next node is the new tree node
+            hash->slots[i] = next;
+        } else {
+            RBT_hash_erase(hash, i);
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_hash.h                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_hash.h contains declarations of functions for an RBT with a hash index
+// from each capacity in the tree to its tree node (the head of the linked
+// list of nodes with that capacity).
+//
+// Requests for a capacity that is in the tree are served from its list in
+// O(1) expected time. Other requests fall back to the O(log n) tree search.
+// Removals are always best fits, as with RBT_remove_at_least.
+//
+// The index is an open-addressing hash table with linear probing. Its size is
+// a power of 2 and it is doubled whenever it becomes half full. It is kept
+// consistent by the RBT_hash_* functions, so the tree must not be modified by
+// other means (e.g. RBT_add) while it is in use.
+
+#ifndef RBT_HASH_H
+#define RBT_HASH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rbt.h"
+
+#define RBT_HASH_MIN_SLOTS 16 // initial number of slots in the index
+
+// Hash-indexed RBT data type.
+typedef struct RBT_hash {
+    RBT root;      // the tree
+    RBT *slots;    // tree nodes, by capacity (NULL for empty slots)
+    size_t mask;   // number of slots - 1
+    size_t size;   // number of tree nodes (distinct capacities)
+    size_t hits;   // number of requests served by the index
+    size_t misses; // number of requests that searched the tree
+} RBT_hash;
+
+// RBT_hash_init initializes `hash` to an empty tree. Returns false if memory
+// for the index cannot be allocated.
+bool RBT_hash_init(RBT_hash *hash);
+
+// RBT_hash_free frees the index of `hash` (but not the nodes in its tree).
+void RBT_hash_free(RBT_hash *hash);
+
+// RBT_hash_find returns the tree node with the given capacity, or NULL if
+// there is none.
+RBT RBT_hash_find(RBT_hash *hash, unsigned int capacity);
+
+// RBT_hash_add adds `node` with the given capacity to the tree (see RBT_add).
+// Returns false (without adding `node`) if memory for a larger index cannot
+// be allocated.
+bool RBT_hash_add(RBT_hash *hash, RBT node, unsigned int capacity);
+
+// RBT_hash_remove_at_least removes and returns the smallest node whose
+// capacity is at least that requested, or returns NULL if there is none (see
+// RBT_remove_at_least).
+RBT RBT_hash_remove_at_least(RBT_hash *hash, unsigned int capacity);
+
+// RBT_hash_remove_node removes `node` from the tree and returns it, or returns
+// NULL if it is not in the tree (see RBT_remove_node).
+RBT RBT_hash_remove_node(RBT_hash *hash, RBT node);
+
+#endif /* RBT_HASH_H */
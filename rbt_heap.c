@@ -0,0 +1,598 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_heap.c                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_heap.c contains implementations of the functions declared in
+// rbt_heap.h.
+#include "rbt_heap.h"
+#include "rbt_profile.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#define RBT_HEAP_ERROR "\033[31;1mError: \033[0m"
+
+// helper: Returns `n` rounded up to a multiple of RBT_HEAP_ALIGN.
+size_t RBT_heap_round(size_t n) {
+    return (n + RBT_HEAP_ALIGN - 1) & ~(size_t)(RBT_HEAP_ALIGN - 1);
+}
+
+// helper: Returns the header of the block after `block`, or NULL if `block`
+// is the last block in the heap.
+RBT RBT_heap_next(RBT_heap *heap, RBT block) {
+    char *next = (char *)block + heap->header_size + block->capacity;
+    if (next >= heap->end) {
+        return NULL;
+    }
+    return (RBT)next;
+}
+
+// helper: Returns the header of the block before `block`, or NULL if `block`
+// is the first block in the heap.
+RBT RBT_heap_prev(RBT_heap *heap, RBT block) {
+    if ((char *)block == heap->start) {
+        return NULL;
+    }
+    return (RBT)((char *)block - block->prev_dist);
+}
+
+// helper: Inserts a free block into the index. RBT_add clears every field
+// but capacity, so `prev_dist` is saved and restored around it.
+void RBT_heap_insert(RBT_heap *heap, RBT block, unsigned int capacity) {
+    unsigned int prev_dist = block->prev_dist;
+    heap->root = RBT_add(heap->root, block, capacity);
+    block->prev_dist = prev_dist;
+    heap->free_bytes += capacity;
+}
+
+// helper: Removes a free block from the index.
+void RBT_heap_remove(RBT_heap *heap, RBT block) {
+    RBT removed;
+    heap->root = RBT_remove_node(heap->root, block, &removed);
+    heap->free_bytes -= block->capacity;
+}
+
+// helper: Makes `block` the previous block of the one after it (if any).
+void RBT_heap_link_next(RBT_heap *heap, RBT block) {
+    RBT next = RBT_heap_next(heap, block);
+    if (next != NULL) {
+        next->prev_dist = heap->header_size + block->capacity;
+    }
+}
+
+// helper: Divides the bytes from `start` to `end` into free blocks of at most
+// heap->max_capacity bytes and inserts them into the index. `prev_dist` is
+// the distance back from `start` to the previous block. Returns the distance
+// back from `end` to the last block carved.
+unsigned int RBT_heap_carve(RBT_heap *heap, char *start, char *end,
+                            unsigned int prev_dist) {
+    char *header = start;
+    while (header < end) {
+        size_t capacity = end - header - heap->header_size;
+        if (capacity > heap->max_capacity) {
+            capacity = heap->max_capacity;
+            size_t rest = end - (header + heap->header_size + capacity);
+            if (rest != 0 && rest < heap->min_block) {
+                // leave room for the last block
+                capacity -= heap->min_block;
+            }
+        }
+        RBT block = (RBT)header;
+        block->prev_dist = prev_dist;
+        RBT_heap_insert(heap, block, capacity);
+        prev_dist = heap->header_size + capacity;
+        header += prev_dist;
+    }
+    return prev_dist;
+}
+
+unsigned int RBT_heap_class(RBT_heap *heap, size_t size) {
+    // with a split header, capacities are `pad` bytes short of a multiple of
+    // the alignment, so that the next payload is aligned
+    size_t pad = heap->header_size % RBT_HEAP_ALIGN;
+    size_t capacity = RBT_heap_round(size + pad) - pad;
+    if (capacity < heap->min_block - heap->header_size) {
+        capacity = heap->min_block - heap->header_size;
+    }
+    if (heap->class_bits == 0 || capacity <= RBT_HEAP_CLASS_LINEAR) {
+        return capacity;
+    }
+    // round up to a multiple of 2^-class_bits of the largest power of 2 below
+    size_t bytes = capacity + pad;
+    unsigned int bits = 8 * sizeof(unsigned long) - 1 - __builtin_clzl(bytes);
+    size_t step = (size_t)1 << (bits > heap->class_bits ? bits - heap->class_bits : 0);
+    if (step < RBT_HEAP_ALIGN) {
+        step = RBT_HEAP_ALIGN;
+    }
+    size_t rounded = ((bytes + step - 1) & ~(step - 1)) - pad;
+    return rounded > heap->max_capacity ? capacity : rounded;
+}
+
+// helper: Initializes `heap` (see RBT_heap_init) with headers of
+// `header_size` bytes.
+bool RBT_heap_setup(RBT_heap *heap, void *mem, size_t size, RBT_fit fit,
+                    size_t header_size) {
+    // the first payload (after the first header) is aligned
+    size_t pad = header_size % RBT_HEAP_ALIGN;
+    char *start = (char *)RBT_heap_round((uintptr_t)mem + pad) - pad;
+    char *end = (char *)mem + size;
+    heap->header_size = header_size;
+    // every block has a payload, and a free block holds a whole node (whose
+    // links overlay the payload, with a split header)
+    heap->min_block = RBT_heap_round(header_size + 1);
+    if (heap->min_block < sizeof(struct RBT)) {
+        heap->min_block = RBT_heap_round(sizeof(struct RBT));
+    }
+    // (so that the distance between two headers fits in `prev_dist`)
+    heap->max_capacity = RBT_HEAP_MAX_CAPACITY - header_size;
+    heap->root = NULL;
+    heap->start = start;
+    heap->end = start;
+    heap->fit = fit;
+    heap->free_bytes = 0;
+    heap->used_bytes = 0;
+    heap->bin_count = 0;
+    heap->bin_limit = RBT_HEAP_BIN_SIZE;
+    heap->staged_bytes = 0;
+    heap->bin_hits = 0;
+    heap->class_bits = 0;
+    heap->profile = NULL;
+    if (end < start + heap->min_block) {
+        return false;
+    }
+    end = start + ((end - start) & ~(size_t)(RBT_HEAP_ALIGN - 1));
+    heap->end = end;
+    RBT_heap_carve(heap, start, end, 0);
+    return true;
+}
+
+bool RBT_heap_init(RBT_heap *heap, void *mem, size_t size, RBT_fit fit) {
+    return RBT_heap_setup(heap, mem, size, fit, sizeof(struct RBT));
+}
+
+bool RBT_heap_init_split(RBT_heap *heap, void *mem, size_t size, RBT_fit fit) {
+    return RBT_heap_setup(heap, mem, size, fit, RBT_HEAP_SPLIT_HEADER);
+}
+
+// helper: RBT_heap_alloc without the profile.
+void *RBT_heap_alloc_block(RBT_heap *heap, size_t size) {
+    if (size > heap->max_capacity) {
+        return NULL;
+    }
+    unsigned int capacity = RBT_heap_class(heap, size);
+
+    // look for an exact fit among the staged blocks, most recent first
+    for (size_t i = heap->bin_count; i-- > 0; ) {
+        RBT block = heap->bin[i];
+        if (block->capacity == capacity) {
+            for (; i + 1 < heap->bin_count; i++) {
+                heap->bin[i] = heap->bin[i + 1];
+            }
+            heap->bin_count--;
+            heap->staged_bytes -= capacity;
+            heap->used_bytes += capacity;
+            heap->bin_hits++;
+            return (char *)block + heap->header_size;
+        }
+    }
+    if (heap->bin_count != 0) {
+        RBT_heap_flush(heap);
+    }
+
+    RBT block;
+    heap->root = RBT_remove_fit(heap->root, &heap->fit, capacity, &block);
+    if (block == NULL) {
+        return NULL;
+    }
+    heap->free_bytes -= block->capacity;
+
+    // split off any remainder large enough to be a block of its own
+    if (block->capacity > capacity && block->capacity - capacity >= heap->min_block) {
+        RBT rest = (RBT)((char *)block + heap->header_size + capacity);
+        unsigned int rest_capacity = block->capacity - capacity - heap->header_size;
+        rest->prev_dist = heap->header_size + capacity;
+        block->capacity = capacity;
+        RBT_heap_insert(heap, rest, rest_capacity);
+        RBT_heap_link_next(heap, rest);
+    }
+    block->in_use = true;
+    heap->used_bytes += block->capacity;
+    return (char *)block + heap->header_size;
+}
+
+void *RBT_heap_alloc(RBT_heap *heap, size_t size) {
+    void *ptr = RBT_heap_alloc_block(heap, size);
+    if (ptr != NULL && heap->profile != NULL) {
+        RBT_profile_alloc(heap->profile, ptr, size);
+    }
+    return ptr;
+}
+
+// helper: Marks `block` as free, coalesces it with its free neighbors and
+// inserts the result into the index.
+void RBT_heap_release(RBT_heap *heap, RBT block) {
+    size_t capacity = block->capacity;
+    block->in_use = false;
+
+    // coalesce with the next block
+    RBT next = RBT_heap_next(heap, block);
+    if (next != NULL && !next->in_use &&
+            capacity + heap->header_size + next->capacity <= heap->max_capacity) {
+        RBT_heap_remove(heap, next);
+        capacity += heap->header_size + next->capacity;
+    }
+    // coalesce with the previous block
+    RBT prev = RBT_heap_prev(heap, block);
+    if (prev != NULL && !prev->in_use &&
+            prev->capacity + heap->header_size + capacity <= heap->max_capacity) {
+        RBT_heap_remove(heap, prev);
+        capacity += heap->header_size + prev->capacity;
+        block = prev;
+    }
+    block->capacity = capacity;
+    RBT_heap_link_next(heap, block);
+    RBT_heap_insert(heap, block, capacity);
+}
+
+void RBT_heap_free(RBT_heap *heap, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    if (heap->profile != NULL) {
+        RBT_profile_free(heap->profile, ptr);
+    }
+    RBT block = (RBT)((char *)ptr - heap->header_size);
+    heap->used_bytes -= block->capacity;
+    if (heap->bin_limit == 0) {
+        RBT_heap_release(heap, block);
+        return;
+    }
+    // (limits above the size of the bin are clamped to it)
+    if (heap->bin_count >= heap->bin_limit || heap->bin_count >= RBT_HEAP_BIN_SIZE) {
+        RBT_heap_flush(heap);
+    }
+    // stage the block (it stays in use until it is flushed)
+    heap->bin[heap->bin_count++] = block;
+    heap->staged_bytes += block->capacity;
+}
+
+// helper: qsort comparator for blocks by address.
+int RBT_heap_compare(const void *a, const void *b) {
+    RBT x = *(const RBT *)a;
+    RBT y = *(const RBT *)b;
+    return (x > y) - (x < y);
+}
+
+// helper: Releases `count` blocks (see RBT_heap_release), after sorting them
+// by address and merging runs of adjacent blocks, so that each run costs a
+// single insertion into the index.
+void RBT_heap_release_all(RBT_heap *heap, RBT *blocks, size_t count) {
+    qsort(blocks, count, sizeof(RBT), RBT_heap_compare);
+    for (size_t i = 0; i < count; i++) {
+        RBT block = blocks[i];
+        while (i + 1 < count && RBT_heap_next(heap, block) == blocks[i + 1] &&
+                block->capacity + heap->header_size + blocks[i + 1]->capacity <=
+                    heap->max_capacity) {
+            i++;
+            block->capacity += heap->header_size + blocks[i]->capacity;
+        }
+        RBT_heap_release(heap, block);
+    }
+}
+
+void RBT_heap_flush(RBT_heap *heap) {
+    for (size_t i = 0; i < heap->bin_count; i++) {
+        heap->staged_bytes -= heap->bin[i]->capacity;
+    }
+    RBT_heap_release_all(heap, heap->bin, heap->bin_count);
+    heap->bin_count = 0;
+}
+
+void RBT_heap_free_batch(RBT_heap *heap, void **ptrs, size_t count) {
+    // convert the pointers to headers in place
+    RBT *blocks = (RBT *)ptrs;
+    size_t num_blocks = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ptrs[i] != NULL) {
+            if (heap->profile != NULL) {
+                RBT_profile_free(heap->profile, ptrs[i]);
+            }
+            RBT block = (RBT)((char *)ptrs[i] - heap->header_size);
+            heap->used_bytes -= block->capacity;
+            blocks[num_blocks++] = block;
+        }
+    }
+    RBT_heap_release_all(heap, blocks, num_blocks);
+}
+
+// helper: Sorts the list of payloads starting at `head` (each holding a
+// pointer to the next in its first word) by address, with a bottom-up merge
+// sort that needs no extra memory. Returns the new head.
+void *RBT_heap_sort_list(void *head) {
+    for (size_t width = 1; ; width *= 2) {
+        void *sorted = NULL;
+        void **tail = &sorted;
+        size_t merges = 0;
+        void *p = head;
+        while (p != NULL) {
+            // merge the run of `width` payloads at p with the one after it
+            merges++;
+            void *q = p;
+            size_t p_size = 0;
+            while (p_size < width && q != NULL) {
+                q = *(void **)q;
+                p_size++;
+            }
+            size_t q_size = width;
+            while (p_size > 0 || (q_size > 0 && q != NULL)) {
+                void *next;
+                if (p_size > 0 && (q_size == 0 || q == NULL || (char *)p < (char *)q)) {
+                    next = p;
+                    p = *(void **)p;
+                    p_size--;
+                } else {
+                    next = q;
+                    q = *(void **)q;
+                    q_size--;
+                }
+                *tail = next;
+                tail = (void **)next;
+            }
+            p = q;
+        }
+        *tail = NULL;
+        head = sorted;
+        if (merges <= 1) {
+            return head;
+        }
+    }
+}
+
+void RBT_heap_free_list(RBT_heap *heap, void *head) {
+    // merge runs of adjacent blocks (see RBT_heap_release_all)
+    RBT run = NULL;
+    void *ptr = RBT_heap_sort_list(head);
+    while (ptr != NULL) {
+        void *next = *(void **)ptr; // (read before the block is released)
+        if (heap->profile != NULL) {
+            RBT_profile_free(heap->profile, ptr);
+        }
+        RBT block = (RBT)((char *)ptr - heap->header_size);
+        heap->used_bytes -= block->capacity;
+        if (run != NULL && RBT_heap_next(heap, run) == block &&
+                run->capacity + heap->header_size + block->capacity <= heap->max_capacity) {
+            run->capacity += heap->header_size + block->capacity;
+        } else {
+            if (run != NULL) {
+                RBT_heap_release(heap, run);
+            }
+            run = block;
+        }
+        ptr = next;
+    }
+    if (run != NULL) {
+        RBT_heap_release(heap, run);
+    }
+}
+
+void *RBT_heap_alloc_aligned(RBT_heap *heap, size_t size, size_t align) {
+    return RBT_heap_alloc_aligned_at(heap, size, align, 0);
+}
+
+void *RBT_heap_alloc_aligned_at(RBT_heap *heap, size_t size, size_t align,
+                                size_t offset) {
+    if (offset % RBT_HEAP_ALIGN != 0 || (offset != 0 && offset >= align)) {
+        return NULL;
+    }
+    if (align <= RBT_HEAP_ALIGN) {
+        return RBT_heap_alloc(heap, size);
+    }
+    if ((align & (align - 1)) != 0 || size > heap->max_capacity) {
+        return NULL;
+    }
+    unsigned int capacity = RBT_heap_class(heap, size);
+    if (capacity > heap->max_capacity ||
+            align > heap->max_capacity - capacity - heap->min_block) {
+        return NULL;
+    }
+    // over-allocate, so that an aligned payload of the rounded capacity fits
+    // after a leading block
+    char *ptr = RBT_heap_alloc_block(heap, capacity + align + heap->min_block);
+    if (ptr == NULL) {
+        return NULL;
+    }
+    RBT block = (RBT)(ptr - heap->header_size);
+    uintptr_t base = ((uintptr_t)ptr - offset + align - 1) & ~(uintptr_t)(align - 1);
+    char *aligned = (char *)base + offset;
+    if (aligned != ptr && (size_t)(aligned - ptr) < heap->min_block) {
+        aligned += align;
+    }
+
+    // free the part before the aligned payload
+    if (aligned != ptr) {
+        unsigned int lead = aligned - ptr;
+        RBT aligned_block = (RBT)(aligned - heap->header_size);
+        aligned_block->capacity = block->capacity - lead;
+        aligned_block->prev_dist = lead;
+        aligned_block->in_use = true;
+        RBT_heap_link_next(heap, aligned_block);
+        block->capacity = lead - heap->header_size;
+        heap->used_bytes -= lead;
+        RBT_heap_release(heap, block);
+        block = aligned_block;
+    }
+    // free the part after it
+    if (block->capacity > capacity && block->capacity - capacity >= heap->min_block) {
+        RBT rest = (RBT)((char *)block + heap->header_size + capacity);
+        rest->capacity = block->capacity - capacity - heap->header_size;
+        rest->prev_dist = heap->header_size + capacity;
+        heap->used_bytes -= block->capacity - capacity;
+        block->capacity = capacity;
+        RBT_heap_release(heap, rest);
+    }
+    if (heap->profile != NULL) {
+        RBT_profile_alloc(heap->profile, aligned, size);
+    }
+    return aligned;
+}
+
+// helper: qsort comparator for pointers to payload pointers, by payload.
+int RBT_heap_compare_slots(const void *a, const void *b) {
+    char *x = **(char **const *)a;
+    char *y = **(char **const *)b;
+    return (x > y) - (x < y);
+}
+
+bool RBT_heap_compact(RBT_heap *heap, void **slots, size_t count) {
+    // sort the movable blocks by address, so that they are met in one pass
+    void ***movable = malloc(count * sizeof(void **));
+    if (movable == NULL && count != 0) {
+        return false;
+    }
+    size_t num_movable = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (slots[i] != NULL) {
+            movable[num_movable++] = &slots[i];
+        }
+    }
+    qsort(movable, num_movable, sizeof(void **), RBT_heap_compare_slots);
+    RBT_heap_flush(heap);
+
+    // every free block is overwritten or carved again, so the index is rebuilt
+    // from scratch
+    heap->root = NULL;
+    heap->free_bytes = 0;
+    char *dest = heap->start;   // where the next block in use goes
+    unsigned int prev_dist = 0; // distance back from `dest` to the last block
+    size_t j = 0;
+    char *header = heap->start;
+    while (header < heap->end) {
+        RBT block = (RBT)header;
+        size_t size = heap->header_size + block->capacity;
+        if (j < num_movable && (char *)*movable[j] - heap->header_size < header) {
+            printf(RBT_HEAP_ERROR "%p is not the payload of a block in use\n",
+                    *movable[j]);
+            raise(SIGABRT);
+        }
+        if (block->in_use) {
+            if (j < num_movable && (char *)*movable[j] - heap->header_size == header) {
+                // slide it down
+                memmove(dest, header, size);
+                *movable[j++] = dest + heap->header_size;
+                if (heap->profile != NULL) {
+                    RBT_profile_move(heap->profile, header + heap->header_size,
+                            dest + heap->header_size);
+                }
+            } else if (dest != header) {
+                // it is pinned: the space before it becomes free
+                prev_dist = RBT_heap_carve(heap, dest, header, prev_dist);
+                dest = header;
+            }
+            ((RBT)dest)->prev_dist = prev_dist;
+            prev_dist = size;
+            dest += size;
+        }
+        header += size;
+    }
+    if (j < num_movable) { // (inside or past the last block)
+        printf(RBT_HEAP_ERROR "%p is not the payload of a block in use\n",
+                *movable[j]);
+        raise(SIGABRT);
+    }
+    RBT_heap_carve(heap, dest, heap->end, prev_dist);
+    free(movable);
+    return true;
+}
+
+size_t RBT_heap_usable_size(RBT_heap *heap, void *ptr) {
+    return ((RBT)((char *)ptr - heap->header_size))->capacity;
+}
+
+// helper: Returns whether `block` is in the staging bin.
+bool RBT_heap_staged(RBT_heap *heap, RBT block) {
+    for (size_t i = 0; i < heap->bin_count; i++) {
+        if (heap->bin[i] == block) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RBT_heap_get_stats(RBT_heap *heap, RBT_heap_stats *stats) {
+    *stats = (RBT_heap_stats){0};
+    for (RBT block = (RBT)heap->start; (char *)block < heap->end;
+            block = (RBT)((char *)block + heap->header_size + block->capacity)) {
+        if (block->in_use && RBT_heap_staged(heap, block)) {
+            stats->staged_blocks++;
+            stats->staged_bytes += block->capacity;
+        } else if (block->in_use) {
+            stats->used_blocks++;
+            stats->used_bytes += block->capacity;
+        } else {
+            stats->free_blocks++;
+            stats->free_bytes += block->capacity;
+            if (block->capacity > stats->largest_free) {
+                stats->largest_free = block->capacity;
+            }
+        }
+    }
+}
+
+// helper: Returns the number of nodes in an RBT (including duplicates).
+size_t RBT_heap_count(RBT root) {
+    size_t count = 0;
+    RBT_cursor cursor;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next_block(&cursor)) {
+        count++;
+    }
+    return count;
+}
+
+void RBT_heap_ok(RBT_heap *heap) {
+    RBT prev = NULL;
+    for (RBT block = (RBT)heap->start; (char *)block < heap->end;
+            block = (RBT)((char *)block + heap->header_size + block->capacity)) {
+        unsigned int prev_dist = prev == NULL ? 0 : heap->header_size + prev->capacity;
+        if (block->prev_dist != prev_dist) {
+            printf(RBT_HEAP_ERROR "block %p has prev_dist %u (expected %u)\n",
+                    (void *)block, block->prev_dist, prev_dist);
+            raise(SIGABRT);
+        }
+        if ((heap->header_size + block->capacity) % RBT_HEAP_ALIGN != 0) {
+            printf(RBT_HEAP_ERROR "block %p has unaligned capacity %u\n",
+                    (void *)block, block->capacity);
+            raise(SIGABRT);
+        }
+        if (prev != NULL && !prev->in_use && !block->in_use &&
+                prev->capacity + heap->header_size + block->capacity <= heap->max_capacity) {
+            printf(RBT_HEAP_ERROR "free blocks %p and %p should be coalesced\n",
+                    (void *)prev, (void *)block);
+            raise(SIGABRT);
+        }
+        prev = block;
+    }
+    if (prev != NULL && (char *)prev + heap->header_size + prev->capacity != heap->end) {
+        printf(RBT_HEAP_ERROR "last block does not end at the end of the heap\n");
+        raise(SIGABRT);
+    }
+
+    RBT_heap_stats stats;
+    RBT_heap_get_stats(heap, &stats);
+    if (stats.free_bytes != heap->free_bytes || stats.used_bytes != heap->used_bytes ||
+            stats.staged_bytes != heap->staged_bytes) {
+        printf(RBT_HEAP_ERROR "heap byte counts do not match its blocks\n");
+        raise(SIGABRT);
+    }
+    if (stats.free_blocks != RBT_heap_count(heap->root)) {
+        printf(RBT_HEAP_ERROR "heap index does not contain every free block\n");
+        raise(SIGABRT);
+    }
+    if (stats.staged_blocks != heap->bin_count) {
+        printf(RBT_HEAP_ERROR "staging bin contains blocks that are not in use\n");
+        raise(SIGABRT);
+    }
+}
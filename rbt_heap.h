@@ -0,0 +1,192 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_heap.h                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_heap.h contains declarations of functions for a heap allocator that
+// manages a caller-supplied region of memory, using an RBT as its index of
+// free blocks.
+//
+// The region is divided into contiguous blocks. Every block begins with a
+// `struct RBT` header followed by `capacity` bytes of payload:
+//
+//   | header | payload ... | header | payload ... | ...
+//   ^ prev_dist ----------->
+//
+// A heap initialized with RBT_heap_init_split uses split headers instead: the
+// header of each block is only the RBT_HEAP_SPLIT_HEADER bytes holding its
+// capacity, `prev_dist` and flags, and the links of a free block's node
+// overlay the start of its payload (so its capacity is at least 24 bytes):
+//
+//   | capacity, prev_dist, ... | payload ...                         |
+//   | capacity, prev_dist, ... | left | right | next | (unused) ... |
+//
+// This saves 24 bytes per block in use, at the cost of capacities that are 8
+// bytes short of a multiple of RBT_HEAP_ALIGN.
+//
+// A block's `prev_dist` is the distance (in bytes) back to the previous
+// header (0 for the first block), and `in_use` is set while the block is
+// allocated. Free blocks are nodes in the RBT. Blocks are split when
+// allocated and coalesced with free neighbors when freed.
+//
+// Freed blocks first go into a small staging bin, where they stay marked as
+// in use (so that they are not coalesced). Allocations scan the bin for a
+// block of exactly the rounded size before searching the RBT, so a block that
+// is reallocated soon after it is freed never enters the RBT. The bin is
+// flushed into the RBT when it overflows and when an allocation misses it.
+//
+// Optionally, requests are rounded up to size classes: multiples of
+// RBT_HEAP_ALIGN up to RBT_HEAP_CLASS_LINEAR bytes, then 2^class_bits classes
+// per power of 2 (e.g. class_bits = 3 gives classes 12.5% apart). Freed
+// blocks then share a few capacities, so the RBT has fewer distinct keys (and
+// longer duplicate lists) and more requests find an exact fit, at the cost of
+// the bytes wasted by rounding.
+//
+// Optionally, a sampling profile (see rbt_profile.h) records the call stacks
+// of a sample of the allocations, weighted by size, for as long as they live.
+
+#ifndef RBT_HEAP_H
+#define RBT_HEAP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rbt.h"
+#include "rbt_fit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RBT_HEAP_ALIGN 16 // alignment (in bytes) of every payload
+
+// Size (in bytes) of a split header (the fields of a `struct RBT` before its
+// links).
+#define RBT_HEAP_SPLIT_HEADER 8
+
+// Largest size (in bytes) of a block, including its header, so that the
+// distance between two headers fits in `prev_dist`. The largest capacity of a
+// block is this less the header size (see `max_capacity` below).
+#define RBT_HEAP_MAX_CAPACITY ((1u << 30) - RBT_HEAP_ALIGN)
+
+#define RBT_HEAP_BIN_SIZE 8 // largest number of blocks in the staging bin
+
+// Largest capacity (in bytes) rounded to a multiple of RBT_HEAP_ALIGN alone
+// when size classes are enabled (see `class_bits` below).
+#define RBT_HEAP_CLASS_LINEAR 512
+
+struct RBT_profile;
+
+// Heap data type.
+typedef struct RBT_heap {
+    RBT root;            // index of free blocks
+    char *start;         // header of the first block
+    char *end;           // end of the region
+    RBT_fit fit;         // placement policy
+    size_t free_bytes;   // number of payload bytes in free blocks
+    size_t used_bytes;   // number of payload bytes in blocks in use
+    RBT bin[RBT_HEAP_BIN_SIZE]; // staged blocks, in the order they were freed
+    size_t bin_count;    // number of blocks in `bin`
+    size_t bin_limit;    // number of blocks staged before a flush (0 disables)
+    size_t staged_bytes; // number of payload bytes in staged blocks
+    size_t bin_hits;     // number of allocations served by the bin
+    unsigned int class_bits; // log2 of the size classes per doubling (0 disables)
+    size_t header_size;  // number of bytes in a block header
+    size_t min_block;    // smallest block (header and payload)
+    size_t max_capacity; // largest capacity of a block
+    struct RBT_profile *profile; // sampling profile of allocations (NULL disables)
+} RBT_heap;
+
+// Heap statistics (computed by walking every block).
+typedef struct RBT_heap_stats {
+    size_t free_blocks;   // number of free blocks
+    size_t used_blocks;   // number of blocks in use
+    size_t free_bytes;    // number of payload bytes in free blocks
+    size_t used_bytes;    // number of payload bytes in blocks in use
+    size_t largest_free;  // capacity of the largest free block
+    size_t staged_blocks; // number of blocks in the staging bin
+    size_t staged_bytes;  // number of payload bytes in staged blocks
+} RBT_heap_stats;
+
+// RBT_heap_init initializes `heap` to manage the `size` bytes at `mem` using
+// the given placement policy. Returns false (leaving `heap` unusable) if the
+// region is too small to hold a single block.
+// The staging bin holds up to RBT_HEAP_BIN_SIZE blocks; set `bin_limit` to a
+// smaller number (or 0, to disable the bin) afterwards (larger numbers act as
+// RBT_HEAP_BIN_SIZE). Size classes are disabled; set `class_bits` to enable
+// them. No profile is attached; set `profile` to an initialized RBT_profile to
+// sample allocations.
+bool RBT_heap_init(RBT_heap *heap, void *mem, size_t size, RBT_fit fit);
+
+// RBT_heap_init_split is like RBT_heap_init, but the heap uses split headers
+// (see above).
+bool RBT_heap_init_split(RBT_heap *heap, void *mem, size_t size, RBT_fit fit);
+
+// RBT_heap_alloc returns a pointer to at least `size` bytes of memory aligned
+// to RBT_HEAP_ALIGN bytes, or NULL if no free block is large enough.
+void *RBT_heap_alloc(RBT_heap *heap, size_t size);
+
+// RBT_heap_alloc_aligned returns a pointer to at least `size` bytes of memory
+// aligned to `align` bytes (a power of 2), or NULL if no free block is large
+// enough. The memory is freed with RBT_heap_free.
+void *RBT_heap_alloc_aligned(RBT_heap *heap, size_t size, size_t align);
+
+// RBT_heap_alloc_aligned_at is like RBT_heap_alloc_aligned, but the returned
+// pointer is `offset` bytes past a multiple of `align` (`offset` must be a
+// multiple of RBT_HEAP_ALIGN less than `align`, or NULL is returned).
+void *RBT_heap_alloc_aligned_at(RBT_heap *heap, size_t size, size_t align,
+                                size_t offset);
+
+// RBT_heap_free returns the memory at `ptr` (which must have been returned by
+// RBT_heap_alloc on the same heap) to the heap. Does nothing if `ptr` is NULL.
+void RBT_heap_free(RBT_heap *heap, void *ptr);
+
+// RBT_heap_free_batch returns the memory at each of the `count` pointers in
+// `ptrs` to the heap, as RBT_heap_free does (skipping NULL pointers), but
+// without staging them: they are sorted by address and adjacent blocks are
+// merged before they are inserted into the RBT. The contents of `ptrs` are
+// overwritten.
+void RBT_heap_free_batch(RBT_heap *heap, void **ptrs, size_t count);
+
+// RBT_heap_free_list is like RBT_heap_free_batch, but for a list of payloads
+// starting at `head`, each of which holds a pointer to the next (or NULL) in
+// its first word. The list is sorted in place, so no memory is allocated.
+void RBT_heap_free_list(RBT_heap *heap, void *head);
+
+// RBT_heap_flush moves every block in the staging bin into the RBT,
+// coalescing it with its free neighbors.
+void RBT_heap_flush(RBT_heap *heap);
+
+// RBT_heap_compact flushes the staging bin and then slides blocks in use
+// toward the start of the heap. Only the blocks whose payloads are among the
+// `count` pointers in `slots` (skipping NULL pointers) are moved, and those
+// pointers are updated to their new addresses. Every other block in use stays
+// where it is, so the free space between each pair of such blocks (and after
+// the last one) ends up as a single free block. Returns false (without
+// changing the heap) if out of memory.
+//
+// Each pointer in `slots` must have been returned by RBT_heap_alloc on this
+// heap and not freed, or SIGABRT is raised.
+bool RBT_heap_compact(RBT_heap *heap, void **slots, size_t count);
+
+// RBT_heap_class returns the capacity of the block that `heap` allocates for
+// a request of `size` bytes (which must be at most `heap->max_capacity`).
+unsigned int RBT_heap_class(RBT_heap *heap, size_t size);
+
+// RBT_heap_usable_size returns the number of bytes that may be used at `ptr`
+// (which must have been returned by RBT_heap_alloc on the same heap).
+size_t RBT_heap_usable_size(RBT_heap *heap, void *ptr);
+
+// RBT_heap_get_stats stores statistics about every block of the heap in `stats`.
+// Staged blocks are counted separately from free blocks and blocks in use.
+void RBT_heap_get_stats(RBT_heap *heap, RBT_heap_stats *stats);
+
+// RBT_heap_ok checks that the blocks of the heap are consistent: headers are
+// linked by `prev_dist`, no two free blocks are adjacent, the byte counts
+// match and every free block is in the index (or the bin). Raises SIGABRT if
+// not.
+void RBT_heap_ok(RBT_heap *heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RBT_HEAP_H */
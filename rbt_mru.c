@@ -0,0 +1,142 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_mru.c                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_mru.c contains implementations of the functions declared in rbt_mru.h.
+#include "rbt_mru.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// helper: Returns the position of `capacity` in the cache, or -1 if it is not
+// cached.
+int RBT_mru_find(RBT_mru *mru, unsigned int capacity) {
+    for (int i = 0; i < RBT_MRU_SIZE; i++) {
+        if (mru->cache[i] != NULL && mru->cache[i]->capacity == capacity) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// helper: Moves the node at position `i` of the cache to the front.
+void RBT_mru_touch(RBT_mru *mru, int i) {
+    RBT node = mru->cache[i];
+    for (; i > 0; i--) {
+        mru->cache[i] = mru->cache[i - 1];
+    }
+    mru->cache[0] = node;
+}
+
+// helper: Puts `node` at the front of the cache, evicting the least recently
+// used node if necessary.
+void RBT_mru_insert(RBT_mru *mru, RBT node) {
+    int i = RBT_mru_find(mru, node->capacity);
+    if (i < 0) {
+        i = RBT_MRU_SIZE - 1;
+    }
+    mru->cache[i] = node;
+    RBT_mru_touch(mru, i);
+}
+
+// helper: Replaces the cached node at position `i` with `node`, or drops it
+// from the cache if `node` is NULL.
+void RBT_mru_replace(RBT_mru *mru, int i, RBT node) {
+    if (node != NULL) {
+        mru->cache[i] = node;
+        return;
+    }
+    for (; i < RBT_MRU_SIZE - 1; i++) {
+        mru->cache[i] = mru->cache[i + 1];
+    }
+    mru->cache[RBT_MRU_SIZE - 1] = NULL;
+}
+
+// helper: Returns the tree node with the smallest capacity that is at least
+// that requested, or NULL if there is none.
+RBT RBT_mru_lower_bound(RBT root, unsigned int capacity) {
+    RBT best = NULL;
+    while (root != NULL) {
+        unsigned int c = root->capacity;
+        if (capacity == c) {
+            return root;
+        } else if (capacity < c) {
+            best = root;
+            root = root->left;
+        } else {
+            root = root->right;
+        }
+    }
+    return best;
+}
+
+// helper: Removes a node with the same capacity as the tree node `head` and
+// returns it, keeping `head` (if it remains in the tree) at the front of the
+// cache.
+RBT RBT_mru_remove_head(RBT_mru *mru, RBT head) {
+    RBT removed = RBT_remove_duplicate(head);
+    if (removed != NULL) {
+        RBT_mru_insert(mru, head);
+        return removed;
+    }
+    mru->root = RBT_remove_node(mru->root, head, &removed);
+    int i = RBT_mru_find(mru, head->capacity);
+    if (i >= 0) {
+        RBT_mru_replace(mru, i, NULL);
+    }
+    return removed;
+}
+
+void RBT_mru_init(RBT_mru *mru) {
+    mru->root = NULL;
+    for (int i = 0; i < RBT_MRU_SIZE; i++) {
+        mru->cache[i] = NULL;
+    }
+    mru->hits = 0;
+    mru->misses = 0;
+}
+
+void RBT_mru_add(RBT_mru *mru, RBT node, unsigned int capacity) {
+    if (node == NULL) {
+        return;
+    }
+    int i = RBT_mru_find(mru, capacity);
+    if (i >= 0) {
+        mru->hits++;
+        RBT_add_duplicate(mru->cache[i], node);
+        RBT_mru_touch(mru, i);
+        return;
+    }
+    mru->misses++;
+    mru->root = RBT_add(mru->root, node, capacity);
+}
+
+RBT RBT_mru_remove_at_least(RBT_mru *mru, unsigned int capacity) {
+    int i = RBT_mru_find(mru, capacity);
+    RBT head;
+    if (i >= 0) {
+        mru->hits++;
+        head = mru->cache[i];
+    } else {
+        mru->misses++;
+        head = RBT_mru_lower_bound(mru->root, capacity);
+        if (head == NULL) {
+            return NULL;
+        }
+    }
+    return RBT_mru_remove_head(mru, head);
+}
+
+RBT RBT_mru_remove_node(RBT_mru *mru, RBT node) {
+    if (node == NULL) {
+        return NULL;
+    }
+    int i = RBT_mru_find(mru, node->capacity);
+    RBT next = node->next;
+    RBT removed;
+    mru->root = RBT_remove_node(mru->root, node, &removed);
+    if (i >= 0 && removed == mru->cache[i]) { // the next node is the new head
+        RBT_mru_replace(mru, i, next);
+    }
+    return removed;
+}
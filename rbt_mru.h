@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_mru.h                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_mru.h contains declarations of functions for an RBT with a small cache
+// of the most recently used (MRU) tree nodes, for workloads that request the
+// same few capacities in bursts.
+//
+// Every cached node is the head of the linked list for its capacity. Requests
+// for exactly a cached capacity are served from (or added to) that list in
+// O(1) time, without descending the tree. Other requests fall back to the
+// usual O(log n) search, after which the node that served them is cached.
+// Only exact matches are served from the cache, so RBT_mru_remove_at_least
+// always removes a best fit, just as RBT_remove_at_least does.
+//
+// The cache is kept consistent by the RBT_mru_* functions, so the tree must
+// not be modified by other means (e.g. RBT_add) while it is in use.
+
+#ifndef RBT_MRU_H
+#define RBT_MRU_H
+
+#include <stddef.h>
+
+#include "rbt.h"
+
+#define RBT_MRU_SIZE 8 // number of cached tree nodes
+
+// MRU-cached RBT data type.
+typedef struct RBT_mru {
+    RBT root;                // the tree
+    RBT cache[RBT_MRU_SIZE]; // recently used tree nodes, most recent first
+    size_t hits;             // number of requests served by the cache
+    size_t misses;           // number of requests that searched the tree
+} RBT_mru;
+
+// RBT_mru_init initializes `mru` to an empty tree with an empty cache.
+void RBT_mru_init(RBT_mru *mru);
+
+// RBT_mru_add adds `node` with the given capacity to the tree (see RBT_add).
+void RBT_mru_add(RBT_mru *mru, RBT node, unsigned int capacity);
+
+// RBT_mru_remove_at_least removes and returns the smallest node whose capacity
+// is at least that requested, or returns NULL if there is none (see
+// RBT_remove_at_least).
+RBT RBT_mru_remove_at_least(RBT_mru *mru, unsigned int capacity);
+
+// RBT_mru_remove_node removes `node` from the tree and returns it, or returns
+// NULL if it is not in the tree (see RBT_remove_node).
+RBT RBT_mru_remove_node(RBT_mru *mru, RBT node);
+
+#endif /* RBT_MRU_H */
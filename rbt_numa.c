@@ -0,0 +1,169 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_numa.c                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_numa.c contains implementations of the functions declared in
+// rbt_numa.h.
+#define _GNU_SOURCE // getcpu
+#include "rbt_numa.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#define RBT_NUMA_ONLINE "/sys/devices/system/node/online"
+
+// helper: Stores the online NUMA nodes (read from a list such as "0-1,4") in
+// `nodes` and returns their number, or returns 0 if they cannot be read. Nodes
+// outside [0, RBT_NUMA_MAX_NODES) are skipped, since they cannot be bound.
+int RBT_numa_online_nodes(int *nodes) {
+    FILE *file = fopen(RBT_NUMA_ONLINE, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    int count = 0;
+    int first, last;
+    while (count < RBT_NUMA_MAX_NODES && fscanf(file, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(file, "-%d", &last) != 1) {
+            last = first;
+        }
+        for (int node = first; node <= last && count < RBT_NUMA_MAX_NODES; node++) {
+            if (node >= 0 && node < RBT_NUMA_MAX_NODES) {
+                nodes[count++] = node;
+            }
+        }
+        if (fgetc(file) != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+// helper: Binds the `size` bytes at `mem` to NUMA `node` (before they are
+// touched). Returns false if they cannot be bound, or if `node` is not in
+// [0, RBT_NUMA_MAX_NODES).
+bool RBT_numa_bind(void *mem, size_t size, int node) {
+    if (node < 0 || node >= RBT_NUMA_MAX_NODES) {
+        return false;
+    }
+    #if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask[RBT_NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, mem, size, MPOL_BIND, mask, RBT_NUMA_MAX_NODES + 1, 0) == 0;
+    #else
+    return false;
+    #endif
+}
+
+bool RBT_numa_init(RBT_numa *numa, size_t arena_size, RBT_fit fit) {
+    int nodes[RBT_NUMA_MAX_NODES];
+    int num_nodes = RBT_numa_online_nodes(nodes);
+    if (num_nodes == 0) { // degrade to a single, unbound arena
+        nodes[0] = -1;
+        num_nodes = 1;
+    }
+
+    numa->num_arenas = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        RBT_numa_arena *arena = &numa->arenas[i];
+        arena->mem = mmap(NULL, arena_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena->mem == MAP_FAILED) {
+            RBT_numa_destroy(numa);
+            return false;
+        }
+        arena->size = arena_size;
+        arena->node = nodes[i];
+        // (an arena whose memory cannot be bound still serves its node)
+        arena->bound = num_nodes > 1 && RBT_numa_bind(arena->mem, arena_size, arena->node);
+        arena->local_allocs = 0;
+        arena->remote_allocs = 0;
+        pthread_mutex_init(&arena->lock, NULL);
+        numa->num_arenas++;
+        if (!RBT_heap_init(&arena->heap, arena->mem, arena_size, fit)) {
+            RBT_numa_destroy(numa);
+            return false;
+        }
+    }
+    return true;
+}
+
+void RBT_numa_destroy(RBT_numa *numa) {
+    for (int i = 0; i < numa->num_arenas; i++) {
+        munmap(numa->arenas[i].mem, numa->arenas[i].size);
+        pthread_mutex_destroy(&numa->arenas[i].lock);
+    }
+    numa->num_arenas = 0;
+}
+
+int RBT_numa_current_node() {
+    #ifdef __linux__
+    unsigned int cpu, node;
+    if (getcpu(&cpu, &node) == 0) {
+        return node;
+    }
+    #endif
+    return 0;
+}
+
+// helper: Allocates `size` bytes from `arena`, counting the allocation as
+// local or remote. Returns NULL if it has no large enough free block.
+void *RBT_numa_arena_alloc(RBT_numa_arena *arena, size_t size, bool local) {
+    pthread_mutex_lock(&arena->lock);
+    void *ptr = RBT_heap_alloc(&arena->heap, size);
+    if (ptr != NULL && local) {
+        arena->local_allocs++;
+    } else if (ptr != NULL) {
+        arena->remote_allocs++;
+    }
+    pthread_mutex_unlock(&arena->lock);
+    return ptr;
+}
+
+void *RBT_numa_alloc(RBT_numa *numa, size_t size) {
+    int node = RBT_numa_current_node();
+    int home = 0;
+    for (int i = 0; i < numa->num_arenas; i++) {
+        if (numa->arenas[i].node == node) {
+            home = i;
+            break;
+        }
+    }
+    // try the local arena first, then the others in turn
+    for (int i = 0; i < numa->num_arenas; i++) {
+        RBT_numa_arena *arena = &numa->arenas[(home + i) % numa->num_arenas];
+        void *ptr = RBT_numa_arena_alloc(arena, size, arena->node == node);
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+RBT_numa_arena *RBT_numa_arena_of(RBT_numa *numa, void *ptr) {
+    for (int i = 0; i < numa->num_arenas; i++) {
+        RBT_numa_arena *arena = &numa->arenas[i];
+        if ((char *)ptr >= arena->mem && (char *)ptr < arena->mem + arena->size) {
+            return arena;
+        }
+    }
+    return NULL;
+}
+
+void RBT_numa_free(RBT_numa *numa, void *ptr) {
+    RBT_numa_arena *arena = ptr == NULL ? NULL : RBT_numa_arena_of(numa, ptr);
+    if (arena == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&arena->lock);
+    RBT_heap_free(&arena->heap, ptr);
+    pthread_mutex_unlock(&arena->lock);
+}
@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_numa.h                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_numa.h contains declarations of functions for NUMA-aware allocation:
+// one heap (see rbt_heap.h), with its own RBT of free blocks, per NUMA node.
+//
+// Each arena's memory is bound to its node (with mbind), and allocations are
+// served by the arena of the node the calling thread is running on, so that
+// threads use memory that is local to them. If the local arena is full, the
+// other arenas are tried in turn (a "remote" allocation).
+//
+// The nodes are read from /sys/devices/system/node/online. On single-node
+// machines (and if the nodes cannot be determined, e.g. on systems other than
+// Linux), a single unbound arena is used. If memory cannot be bound to a node
+// (e.g. if mbind is not permitted), its arena still serves the threads on that
+// node, but its memory is only local by chance (see `bound`).
+//
+// Each arena has its own lock, so threads on different nodes do not contend.
+
+#ifndef RBT_NUMA_H
+#define RBT_NUMA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "rbt_heap.h"
+
+#define RBT_NUMA_MAX_NODES 64 // largest number of arenas
+
+// A per-node heap.
+typedef struct RBT_numa_arena {
+    pthread_mutex_t lock; // guards `heap` and the counts
+    RBT_heap heap;
+    char *mem;            // memory managed by `heap`
+    size_t size;          // number of bytes at `mem`
+    int node;             // NUMA node served by the arena (-1 if unknown)
+    bool bound;           // whether `mem` is bound to `node`
+    size_t local_allocs;  // allocations by threads on `node`
+    size_t remote_allocs; // allocations by threads on other nodes
+} RBT_numa_arena;
+
+// NUMA-aware allocator data type.
+typedef struct RBT_numa {
+    int num_arenas;
+    RBT_numa_arena arenas[RBT_NUMA_MAX_NODES];
+} RBT_numa;
+
+// RBT_numa_init creates one arena of `arena_size` bytes per NUMA node, each
+// using the given placement policy. Returns false if memory for the arenas
+// cannot be mapped.
+bool RBT_numa_init(RBT_numa *numa, size_t arena_size, RBT_fit fit);
+
+// RBT_numa_destroy unmaps the memory of every arena.
+void RBT_numa_destroy(RBT_numa *numa);
+
+// RBT_numa_current_node returns the NUMA node the calling thread is running
+// on (0 if it cannot be determined).
+int RBT_numa_current_node();
+
+// RBT_numa_alloc returns a pointer to at least `size` bytes, preferably from
+// the arena of the calling thread's node, or NULL if no arena has a large
+// enough free block.
+void *RBT_numa_alloc(RBT_numa *numa, size_t size);
+
+// RBT_numa_free returns the memory at `ptr` (which must have been returned by
+// RBT_numa_alloc on the same allocator, possibly by another thread) to its
+// arena. Does nothing if `ptr` is NULL.
+void RBT_numa_free(RBT_numa *numa, void *ptr);
+
+// RBT_numa_arena_of returns the arena containing `ptr`, or NULL if there is
+// none.
+RBT_numa_arena *RBT_numa_arena_of(RBT_numa *numa, void *ptr);
+
+#endif /* RBT_NUMA_H */
@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_parallel.c                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_parallel.c contains implementations of the functions declared in
+// rbt_parallel.h.
+#include "rbt_parallel.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define RBT_PARALLEL_ERROR "\033[31;1mError: \033[0m"
+
+#ifdef ALLOC_TRACK
+extern unsigned int NUM_NODES; // (see rbt.c)
+#endif // ALLOC_TRACK
+
+// helper: Returns the number of times work may be split in two so that each
+// of (at most) `threads` threads gets a part (0 means one per processor).
+int RBT_parallel_depth(unsigned int threads) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+    int depth = 0;
+    while ((1u << depth) < threads) {
+        depth++;
+    }
+    return depth;
+}
+
+// helper: Runs `task(arg)` on a new thread (stored in `thread`), or on the
+// calling thread if no thread can be created. Returns whether a thread was
+// created (and must be joined).
+bool RBT_parallel_spawn(pthread_t *thread, void *(*task)(void *), void *arg) {
+    if (pthread_create(thread, NULL, task, arg) == 0) {
+        return true;
+    }
+    task(arg);
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Parallel Sort                                                            //
+//////////////////////////////////////////////////////////////////////////////
+// helper: qsort comparator for nodes by capacity.
+int RBT_parallel_compare(const void *a, const void *b) {
+    unsigned int x = (*(const RBT *)a)->capacity;
+    unsigned int y = (*(const RBT *)b)->capacity;
+    return (x > y) - (x < y);
+}
+
+// Part of an array to sort (on its own thread).
+typedef struct RBT_sort_task {
+    RBT *nodes;
+    RBT *tmp;     // scratch space of the same size as `nodes`
+    size_t count;
+    int depth;    // number of times the work may still be split
+} RBT_sort_task;
+
+// helper: Sorts task->nodes by capacity (merge sort, splitting off the first
+// half to a new thread while task->depth > 0).
+void *RBT_parallel_sort(void *arg) {
+    RBT_sort_task *task = arg;
+    if (task->depth == 0 || task->count < RBT_PARALLEL_GRAIN) {
+        qsort(task->nodes, task->count, sizeof(RBT), RBT_parallel_compare);
+        return NULL;
+    }
+    size_t half = task->count / 2;
+    RBT_sort_task left = {task->nodes, task->tmp, half, task->depth - 1};
+    RBT_sort_task right = {task->nodes + half, task->tmp + half,
+            task->count - half, task->depth - 1};
+    pthread_t thread;
+    bool spawned = RBT_parallel_spawn(&thread, RBT_parallel_sort, &left);
+    RBT_parallel_sort(&right);
+    if (spawned) {
+        pthread_join(thread, NULL);
+    }
+
+    // merge the halves
+    size_t i = 0, j = half, k = 0;
+    while (i < half && j < task->count) {
+        if (task->nodes[j]->capacity < task->nodes[i]->capacity) {
+            task->tmp[k++] = task->nodes[j++];
+        } else {
+            task->tmp[k++] = task->nodes[i++];
+        }
+    }
+    while (i < half) {
+        task->tmp[k++] = task->nodes[i++];
+    }
+    while (j < task->count) {
+        task->tmp[k++] = task->nodes[j++];
+    }
+    memcpy(task->nodes, task->tmp, task->count * sizeof(RBT));
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Parallel Build                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// Sorted tree nodes to assemble into a subtree (on its own thread).
+typedef struct RBT_build_task {
+    RBT *heads;    // tree nodes, sorted by capacity
+    size_t count;
+    int level;     // depth of the subtree's root in the whole tree
+    int red_level; // depth of the nodes to color RED
+    int depth;     // number of times the work may still be split
+    RBT root;      // (result) root of the subtree
+} RBT_build_task;
+
+// helper: Assembles task->heads into a balanced subtree rooted at the middle
+// node, building the left subtree on a new thread while task->depth > 0.
+void *RBT_parallel_subtree(void *arg) {
+    RBT_build_task *task = arg;
+    if (task->count == 0) {
+        task->root = BLACK_LEAF;
+        return NULL;
+    }
+    size_t mid = task->count / 2;
+    RBT root = task->heads[mid];
+    int depth = task->depth > 0 ? task->depth - 1 : 0;
+    RBT_build_task left = {.heads = task->heads, .count = mid,
+            .level = task->level + 1, .red_level = task->red_level, .depth = depth};
+    RBT_build_task right = {.heads = task->heads + mid + 1, .count = task->count - mid - 1,
+            .level = task->level + 1, .red_level = task->red_level, .depth = depth};
+    if (task->depth > 0) {
+        pthread_t thread;
+        bool spawned = RBT_parallel_spawn(&thread, RBT_parallel_subtree, &left);
+        RBT_parallel_subtree(&right);
+        if (spawned) {
+            pthread_join(thread, NULL);
+        }
+    } else {
+        RBT_parallel_subtree(&left);
+        RBT_parallel_subtree(&right);
+    }
+    root->left = left.root;
+    root->right = right.root;
+    root->color = task->level == task->red_level && task->level != 0 ? RED : BLACK;
+    task->root = root;
+    return NULL;
+}
+
+RBT RBT_parallel_build(RBT *nodes, size_t count, unsigned int threads) {
+    if (count == 0) {
+        return BLACK_LEAF;
+    }
+    RBT *tmp = malloc(count * sizeof(RBT));
+    if (tmp == NULL) {
+        return BLACK_LEAF;
+    }
+    int depth = RBT_parallel_depth(threads);
+    RBT_sort_task sort = {nodes, tmp, count, depth};
+    RBT_parallel_sort(&sort);
+
+    // link nodes of equal capacity into lists, collecting their heads in `tmp`
+    size_t num_heads = 0;
+    for (size_t i = 0; i < count; i++) {
+        RBT node = nodes[i];
+        node->prev_dist = 0;
+        node->left = NULL;
+        node->right = NULL;
+        node->next = NULL;
+        node->in_use = false;
+        node->color = BLACK;
+        if (num_heads > 0 && tmp[num_heads - 1]->capacity == node->capacity) {
+            RBT_link_duplicate(tmp[num_heads - 1], node);
+        } else {
+            tmp[num_heads++] = node;
+        }
+    }
+
+    // every level but the deepest is full, so the deepest may be RED
+    int red_level = 0;
+    while ((2ul << red_level) <= num_heads) {
+        red_level++;
+    }
+    RBT_build_task build = {.heads = tmp, .count = num_heads, .level = 0,
+            .red_level = red_level, .depth = depth};
+    RBT_parallel_subtree(&build);
+    free(tmp);
+    #ifdef ALLOC_TRACK
+    NUM_NODES += count;
+    #endif // ALLOC_TRACK
+    return build.root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Parallel rep_ok                                                          //
+//////////////////////////////////////////////////////////////////////////////
+// A subtree to check (on its own thread).
+typedef struct RBT_check_task {
+    RBT root;
+    int depth;        // number of times the work may still be split
+    int black_height; // (result) black height of the subtree
+} RBT_check_task;
+
+// helper: Stores the black height of task->root in task->black_height,
+// raising SIGABRT if the subtree violates the RBT invariant. The left subtree
+// is checked on a new thread while task->depth > 0.
+void *RBT_parallel_check(void *arg) {
+    RBT_check_task *task = arg;
+    RBT root = task->root;
+    if (root == BLACK_LEAF) {
+        task->black_height = 0;
+        return NULL;
+    }
+    if (root->color != RED && root->color != BLACK) {
+        printf(RBT_PARALLEL_ERROR "node %u should not be doubly-black\n", root->capacity);
+        raise(SIGABRT);
+    }
+    if (root->color == RED &&
+            ((root->left != BLACK_LEAF && root->left->color == RED) ||
+             (root->right != BLACK_LEAF && root->right->color == RED))) {
+        printf(RBT_PARALLEL_ERROR "tree does not satisfy red-red invariant\n");
+        raise(SIGABRT);
+    }
+    size_t count = 0;
+    for (RBT node = root; node != NULL; node = node->next) {
+        count++;
+    }
+    if (RBT_count(root) != count) {
+        printf(RBT_PARALLEL_ERROR "node %u has count %zu (expected %zu)\n",
+                root->capacity, RBT_count(root), count);
+        raise(SIGABRT);
+    }
+
+    int depth = task->depth > 0 ? task->depth - 1 : 0;
+    RBT_check_task left = {.root = root->left, .depth = depth};
+    RBT_check_task right = {.root = root->right, .depth = depth};
+    if (task->depth > 0) {
+        pthread_t thread;
+        bool spawned = RBT_parallel_spawn(&thread, RBT_parallel_check, &left);
+        RBT_parallel_check(&right);
+        if (spawned) {
+            pthread_join(thread, NULL);
+        }
+    } else {
+        RBT_parallel_check(&left);
+        RBT_parallel_check(&right);
+    }
+    if (left.black_height != right.black_height) {
+        printf(RBT_PARALLEL_ERROR
+                "tree does not satisfy black-height invariant.\n"
+                "    black_height(tree->left):  %d\n"
+                "    black_height(tree->right): %d\n",
+                left.black_height, right.black_height);
+        raise(SIGABRT);
+    }
+    task->black_height = left.black_height + (root->color == BLACK);
+    return NULL;
+}
+
+RBT RBT_parallel_rep_ok(RBT root, unsigned int threads) {
+    if (root == BLACK_LEAF) {
+        return root;
+    }
+    if (root->color != BLACK) {
+        printf(RBT_PARALLEL_ERROR "tree does not satisfy black root invariant\n");
+        raise(SIGABRT);
+    }
+    RBT_check_task check = {.root = root, .depth = RBT_parallel_depth(threads)};
+    RBT_parallel_check(&check);
+    return root;
+}
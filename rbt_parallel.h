@@ -0,0 +1,42 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_parallel.h                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_parallel.h contains declarations of functions that build and validate
+// large RBTs using several threads (POSIX threads), e.g. to rebuild the index
+// of a heap at startup or to check its integrity.
+//
+// Work is split fork-join style: each call divides its input in halves and
+// hands one half to a new thread, down to a depth of log2(threads), so every
+// thread gets a subtree (or a part of the array) of about the same size.
+// If a thread cannot be created, its work is done by the calling thread.
+//
+// Compile (and link) with -pthread.
+
+#ifndef RBT_PARALLEL_H
+#define RBT_PARALLEL_H
+
+#include <stddef.h>
+
+#include "rbt.h"
+
+// Arrays smaller than this are sorted by one thread.
+#define RBT_PARALLEL_GRAIN 4096
+
+// RBT_parallel_build returns a new RBT containing the `count` nodes in
+// `nodes` (each with the capacity stored in its `capacity` field), using up to
+// `threads` threads (or one per online processor, if `threads` is 0). The
+// array is sorted by capacity. Returns NULL if `count` is 0 or if memory
+// for the sort cannot be allocated.
+//
+// The nodes are sorted in parallel, grouped into linked lists of equal
+// capacities and assembled into a perfectly balanced tree whose deepest
+// level is RED (and the rest BLACK). Runs in O(n log n / threads + n) time.
+RBT RBT_parallel_build(RBT *nodes, size_t count, unsigned int threads);
+
+// RBT_parallel_rep_ok checks the same representation invariant as RBT_rep_ok
+// (see rbt.c), checking the subtrees of nodes near the root on separate
+// threads. If the invariant is violated, raises SIGABRT. Otherwise, returns
+// the original tree (unchanged).
+RBT RBT_parallel_rep_ok(RBT root, unsigned int threads);
+
+#endif /* RBT_PARALLEL_H */
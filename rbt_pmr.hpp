@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_pmr.hpp                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_pmr.hpp contains std::pmr::memory_resource adapters for the heap
+// allocator (see rbt_heap.h), so that C++ containers allocate from an
+// RBT-managed region without changes to their code:
+//
+//   rbt::heap_resource resource(mem, size);
+//   std::pmr::vector<int> v(&resource);
+//   std::pmr::unordered_map<int, int> m(&resource);
+//
+// rbt::heap_resource is not synchronized (like RBT_heap itself), so it suits
+// a heap used by one thread at a time, e.g. one resource per thread.
+// rbt::synchronized_heap_resource serializes every allocation and
+// deallocation with a mutex, so that it may be shared between threads.
+//
+// Both adapters either wrap a heap that the caller initialized (and keeps
+// alive) or initialize a heap of their own over a caller-supplied region. The
+// region is not freed when the resource is destroyed.
+
+#ifndef RBT_PMR_HPP
+#define RBT_PMR_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+
+#include "rbt_heap.h"
+
+namespace rbt {
+
+// Unsynchronized memory_resource allocating from an RBT_heap.
+class heap_resource : public std::pmr::memory_resource {
+public:
+    // Allocates from `heap`, which must outlive the resource.
+    explicit heap_resource(RBT_heap *heap) noexcept : heap_(heap) {}
+
+    // Allocates from a heap of its own over the `size` bytes at `mem`, using
+    // the given placement policy. Throws std::invalid_argument if the region
+    // is too small to hold a block (see RBT_heap_init).
+    heap_resource(void *mem, std::size_t size,
+                  RBT_fit fit = RBT_fit_new(RBT_BEST_FIT))
+        : heap_(&own_heap_) {
+        if (!RBT_heap_init(&own_heap_, mem, size, fit)) {
+            throw std::invalid_argument("region is too small for an RBT heap");
+        }
+    }
+
+    heap_resource(const heap_resource &) = delete;
+    heap_resource &operator=(const heap_resource &) = delete;
+
+    // Returns the heap that the resource allocates from.
+    RBT_heap *heap() const noexcept { return heap_; }
+
+protected:
+    // Throws std::bad_alloc if no free block is large enough.
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *ptr = RBT_heap_alloc_aligned(heap_, bytes, alignment);
+        if (ptr == nullptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    void do_deallocate(void *ptr, std::size_t, std::size_t) override {
+        RBT_heap_free(heap_, ptr);
+    }
+
+    // Resources are equal if they allocate from the same heap, since either
+    // one may then free the other's memory.
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const heap_resource *resource = dynamic_cast<const heap_resource *>(&other);
+        return resource != nullptr && resource->heap_ == heap_;
+    }
+
+private:
+    RBT_heap own_heap_;
+    RBT_heap *heap_;
+};
+
+// memory_resource allocating from an RBT_heap under a mutex.
+class synchronized_heap_resource : public heap_resource {
+public:
+    using heap_resource::heap_resource;
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return heap_resource::do_allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        heap_resource::do_deallocate(ptr, bytes, alignment);
+    }
+
+private:
+    std::mutex mutex_;
+};
+
+} // namespace rbt
+
+#endif /* RBT_PMR_HPP */
@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_profile.c                                                            //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_profile.c contains implementations of the functions declared in
+// rbt_profile.h.
+#include "rbt_profile.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <execinfo.h>
+
+#define LN2 0.6931471805599453
+
+// helper: Returns the natural logarithm of `x` (a positive, normal double) to
+// within about 1e-9, without libm.
+double RBT_profile_log(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exponent = (int)((bits >> 52) & 0x7ff) - 1023;
+    // x = m * 2^exponent, with m in [1, 2)
+    bits = (bits & ~((uint64_t)0x7ff << 52)) | ((uint64_t)1023 << 52);
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+    // ln(m) = 2 * atanh(t) = 2 * (t + t^3/3 + t^5/5 + ...), with t < 1/3
+    double t = (m - 1) / (m + 1);
+    double t2 = t * t;
+    double term = t;
+    double sum = 0;
+    for (int k = 1; k <= 17; k += 2) {
+        sum += term / k;
+        term *= t2;
+    }
+    return 2 * sum + exponent * LN2;
+}
+
+// helper: Returns the number of bytes to allocate before the next sample,
+// drawn from an exponential distribution with a mean of profile->rate bytes.
+size_t RBT_profile_interval(RBT_profile *profile) {
+    if (profile->rate <= 1) {
+        return 0;
+    }
+    // xorshift64*
+    uint64_t x = profile->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    profile->random = x;
+    x *= 0x2545F4914F6CDD1DULL;
+    // a uniform number in (0, 1]
+    double u = ((x >> 11) + 1) * (1.0 / 9007199254740992.0);
+    return (size_t)(-RBT_profile_log(u) * profile->rate) + 1;
+}
+
+// helper: Returns the first slot to probe for the sample of the block at `ptr`.
+size_t RBT_profile_slot(void *ptr) {
+    uint64_t h = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (h >> 32) & (RBT_PROFILE_SAMPLES - 1);
+}
+
+// helper: Returns the slot of the sample of the block at `ptr`, or -1 if it
+// was not sampled.
+long RBT_profile_find(RBT_profile *profile, void *ptr) {
+    size_t i = RBT_profile_slot(ptr);
+    while (profile->samples[i].ptr != NULL) {
+        if (profile->samples[i].ptr == ptr) {
+            return i;
+        }
+        i = (i + 1) & (RBT_PROFILE_SAMPLES - 1);
+    }
+    return -1;
+}
+
+// helper: Returns an empty slot for the sample of the block at `ptr` (the
+// table is never full).
+RBT_profile_sample *RBT_profile_insert(RBT_profile *profile, void *ptr) {
+    size_t i = RBT_profile_slot(ptr);
+    while (profile->samples[i].ptr != NULL) {
+        i = (i + 1) & (RBT_PROFILE_SAMPLES - 1);
+    }
+    profile->samples[i].ptr = ptr;
+    profile->num_samples++;
+    return &profile->samples[i];
+}
+
+// helper: Empties slot `i`, shifting back the samples after it that would
+// otherwise no longer be found (so that the table needs no tombstones).
+void RBT_profile_remove(RBT_profile *profile, size_t i) {
+    size_t mask = RBT_PROFILE_SAMPLES - 1;
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (profile->samples[j].ptr == NULL) {
+            break;
+        }
+        // the sample in j may fill slot i if slot i is not after j's first slot
+        size_t home = RBT_profile_slot(profile->samples[j].ptr);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            profile->samples[i] = profile->samples[j];
+            i = j;
+        }
+    }
+    profile->samples[i].ptr = NULL;
+    profile->num_samples--;
+}
+
+void RBT_profile_init(RBT_profile *profile, size_t rate) {
+    profile->rate = rate;
+    profile->random = 0x9E3779B97F4A7C15ULL ^ (uintptr_t)profile;
+    profile->num_samples = 0;
+    profile->sampled = 0;
+    profile->dropped = 0;
+    for (size_t i = 0; i < RBT_PROFILE_SAMPLES; i++) {
+        profile->samples[i].ptr = NULL;
+    }
+    profile->until_sample = RBT_profile_interval(profile);
+    // the first call to backtrace loads libgcc, which allocates
+    void *frame;
+    backtrace(&frame, 1);
+}
+
+void RBT_profile_alloc(RBT_profile *profile, void *ptr, size_t size) {
+    if (size < profile->until_sample) {
+        profile->until_sample -= size;
+        return;
+    }
+    profile->until_sample = RBT_profile_interval(profile);
+    profile->sampled++;
+    if (profile->num_samples >= RBT_PROFILE_SAMPLES / 4 * 3) {
+        profile->dropped++;
+        return;
+    }
+    RBT_profile_sample *sample = RBT_profile_insert(profile, ptr);
+    sample->size = size;
+    // skip this function's own frame
+    void *stack[RBT_PROFILE_DEPTH + 1];
+    int depth = backtrace(stack, RBT_PROFILE_DEPTH + 1) - 1;
+    sample->depth = depth < 0 ? 0 : depth;
+    memcpy(sample->stack, stack + 1, sample->depth * sizeof(void *));
+}
+
+void RBT_profile_free(RBT_profile *profile, void *ptr) {
+    if (profile->num_samples == 0) {
+        return;
+    }
+    long i = RBT_profile_find(profile, ptr);
+    if (i >= 0) {
+        RBT_profile_remove(profile, i);
+    }
+}
+
+void RBT_profile_move(RBT_profile *profile, void *from, void *to) {
+    if (profile->num_samples == 0 || from == to) {
+        return;
+    }
+    long i = RBT_profile_find(profile, from);
+    if (i < 0) {
+        return;
+    }
+    RBT_profile_sample sample = profile->samples[i];
+    RBT_profile_remove(profile, i);
+    RBT_profile_sample *moved = RBT_profile_insert(profile, to);
+    *moved = sample;
+    moved->ptr = to;
+}
+
+// helper: qsort comparator for pointers to samples, by stack.
+int RBT_profile_compare(const void *a, const void *b) {
+    const RBT_profile_sample *x = *(RBT_profile_sample *const *)a;
+    const RBT_profile_sample *y = *(RBT_profile_sample *const *)b;
+    if (x->depth != y->depth) {
+        return x->depth - y->depth;
+    }
+    return memcmp(x->stack, y->stack, x->depth * sizeof(void *));
+}
+
+bool RBT_profile_write(RBT_profile *profile, FILE *out) {
+    RBT_profile_sample **sorted = malloc(profile->num_samples * sizeof(RBT_profile_sample *));
+    if (sorted == NULL && profile->num_samples != 0) {
+        return false;
+    }
+    size_t count = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < RBT_PROFILE_SAMPLES; i++) {
+        if (profile->samples[i].ptr != NULL) {
+            sorted[count++] = &profile->samples[i];
+            bytes += profile->samples[i].size;
+        }
+    }
+    qsort(sorted, count, sizeof(RBT_profile_sample *), RBT_profile_compare);
+
+    // only live blocks are kept, so the allocated counts are the live ones
+    fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+            count, bytes, count, bytes, profile->rate);
+    for (size_t i = 0; i < count; ) {
+        size_t group_count = 0;
+        size_t group_bytes = 0;
+        size_t j = i;
+        for (; j < count && RBT_profile_compare(&sorted[i], &sorted[j]) == 0; j++) {
+            group_count++;
+            group_bytes += sorted[j]->size;
+        }
+        fprintf(out, "%zu: %zu [%zu: %zu] @", group_count, group_bytes,
+                group_count, group_bytes);
+        for (int k = 0; k < sorted[i]->depth; k++) {
+            fprintf(out, " 0x%" PRIxPTR, (uintptr_t)sorted[i]->stack[k]);
+        }
+        fprintf(out, "\n");
+        i = j;
+    }
+    free(sorted);
+
+    // the memory map lets pprof symbolize the addresses
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        fprintf(out, "\nMAPPED_LIBRARIES:\n");
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), maps)) > 0) {
+            fwrite(buffer, 1, n, out);
+        }
+        fclose(maps);
+    }
+    return !ferror(out);
+}
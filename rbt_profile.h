@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_profile.h                                                            //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_profile.h contains declarations of functions for a sampling profiler of
+// the memory allocated from a heap (see rbt_heap.h), attributed to the call
+// stacks that allocated it.
+//
+// Recording every allocation is too costly for a production heap, so
+// allocations are sampled: the number of bytes allocated between two samples
+// is drawn from an exponential distribution with a mean of `rate` bytes, so
+// that samples are a Poisson process over the allocated bytes (and a block of
+// `size` bytes is sampled with probability 1 - exp(-size / rate)). Each
+// sample records the block's address, size and the call stack (from
+// backtrace(3)) in a fixed-size hash table, and is dropped when the block is
+// freed, so the table describes the live memory.
+//
+// Attach a profile to a heap by setting its `profile` field:
+//
+//   static RBT_profile profile;
+//   RBT_profile_init(&profile, RBT_PROFILE_RATE);
+//   heap.profile = &profile;
+//   ...
+//   RBT_profile_write(&profile, stdout);
+//
+// and write it out in the legacy text format of pprof's heap profiles
+// ("heap_v2"), which lists the sampled blocks grouped by stack; pprof scales
+// them back up to estimates of the live bytes (given the rate):
+//
+//   pprof --text ./program heap.prof
+//
+// A profile is not synchronized: it is used under the same lock (if any) as
+// its heap.
+
+#ifndef RBT_PROFILE_H
+#define RBT_PROFILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default mean number of bytes allocated between two samples.
+#define RBT_PROFILE_RATE (512 << 10)
+
+// Number of slots in the table of samples (a power of 2). New samples are
+// dropped while the table is 3/4 full.
+#define RBT_PROFILE_SAMPLES 2048
+
+#define RBT_PROFILE_DEPTH 32 // largest number of frames recorded per sample
+
+// Sampled block.
+typedef struct RBT_profile_sample {
+    void *ptr;   // payload of the block (NULL if the slot is empty)
+    size_t size; // number of bytes requested
+    int depth;   // number of frames in `stack`
+    void *stack[RBT_PROFILE_DEPTH]; // return addresses, innermost first
+} RBT_profile_sample;
+
+// Profile data type.
+typedef struct RBT_profile {
+    size_t rate;         // mean number of bytes between samples
+    size_t until_sample; // number of bytes to allocate before the next sample
+    uint64_t random;     // state of the generator of sampling intervals
+    size_t num_samples;  // number of samples in the table
+    size_t sampled;      // number of samples taken (including freed ones)
+    size_t dropped;      // number of samples dropped (the table was full)
+    RBT_profile_sample samples[RBT_PROFILE_SAMPLES];
+} RBT_profile;
+
+// RBT_profile_init initializes an empty `profile` that samples an average of
+// once every `rate` allocated bytes (every allocation if `rate` is 1).
+void RBT_profile_init(RBT_profile *profile, size_t rate);
+
+// RBT_profile_alloc counts an allocation of `size` bytes at `ptr`, sampling
+// it if the bytes since the last sample reach the current interval. Called by
+// the heap, whose frames are therefore included in the recorded stack.
+void RBT_profile_alloc(RBT_profile *profile, void *ptr, size_t size);
+
+// RBT_profile_free drops the sample of the block at `ptr` (if it was sampled).
+// Called by the heap.
+void RBT_profile_free(RBT_profile *profile, void *ptr);
+
+// RBT_profile_move updates the sample of the block at `from` (if it was
+// sampled) to the block's new address `to`, which must not be the address of
+// another sampled block. Called by RBT_heap_compact.
+void RBT_profile_move(RBT_profile *profile, void *from, void *to);
+
+// RBT_profile_write writes the samples of `profile`, grouped by stack, to
+// `out` in pprof's legacy heap profile format, followed by the memory map of
+// the process (for symbolization). Returns false if out of memory or if
+// writing failed.
+bool RBT_profile_write(RBT_profile *profile, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RBT_PROFILE_H */
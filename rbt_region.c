@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_region.c                                                             //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_region.c contains implementations of the functions declared in
+// rbt_region.h.
+#include "rbt_region.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Offset of the first object in a chunk (after the link to the previous one).
+#define CHUNK_HEADER RBT_HEAP_ALIGN
+
+// helper: Returns `n` rounded up to a multiple of RBT_HEAP_ALIGN.
+size_t RBT_region_round(size_t n) {
+    return (n + RBT_HEAP_ALIGN - 1) & ~(size_t)(RBT_HEAP_ALIGN - 1);
+}
+
+void RBT_region_init(RBT_region *region, RBT_heap *heap, size_t chunk_size) {
+    region->heap = heap;
+    region->chunk_size = chunk_size == 0 ? RBT_REGION_CHUNK : RBT_region_round(chunk_size);
+    region->chunks = NULL;
+    region->top = NULL;
+    region->end = NULL;
+    region->num_chunks = 0;
+    region->bytes = 0;
+}
+
+void *RBT_region_alloc(RBT_region *region, size_t size) {
+    if (size > region->heap->max_capacity - CHUNK_HEADER) {
+        return NULL;
+    }
+    size = size == 0 ? RBT_HEAP_ALIGN : RBT_region_round(size);
+    if (size <= (size_t)(region->end - region->top)) { // bump
+        void *ptr = region->top;
+        region->top += size;
+        region->bytes += size;
+        return ptr;
+    }
+
+    bool own_chunk = size > region->chunk_size / 4;
+    size_t chunk_size = own_chunk ? CHUNK_HEADER + size : region->chunk_size;
+    void **chunk = RBT_heap_alloc(region->heap, chunk_size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    region->num_chunks++;
+    region->bytes += size;
+    char *ptr = (char *)chunk + CHUNK_HEADER;
+    if (own_chunk && region->chunks != NULL) {
+        // link it behind the current chunk, which may still have room
+        void **current = region->chunks;
+        *chunk = *current;
+        *current = chunk;
+        return ptr;
+    }
+    *chunk = region->chunks;
+    region->chunks = chunk;
+    region->top = ptr + size;
+    region->end = (char *)chunk + chunk_size;
+    return ptr;
+}
+
+void RBT_region_reset(RBT_region *region) {
+    // the chunks are already linked through their first word
+    RBT_heap_free_list(region->heap, region->chunks);
+    region->chunks = NULL;
+    region->top = NULL;
+    region->end = NULL;
+    region->num_chunks = 0;
+    region->bytes = 0;
+}
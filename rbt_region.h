@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_region.h                                                             //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_region.h contains declarations of functions for regions (also known as
+// arenas): allocators for objects that are all freed at once, such as the
+// scratch memory of a request.
+//
+// A region takes large chunks from a heap (see rbt_heap.h) and allocates
+// objects from the current chunk by bumping a pointer, chaining a new chunk
+// when it is full. Objects are never freed individually: RBT_region_reset
+// returns every chunk to the heap at once, as a single list (see
+// RBT_heap_free_list), so that adjacent chunks are merged before they are
+// inserted into the tree of free blocks.
+//
+// Every chunk begins with a pointer to the previous chunk:
+//
+//   | prev | object | object | ... |       (unused)        |
+//                                  ^ top                   ^ end
+
+#ifndef RBT_REGION_H
+#define RBT_REGION_H
+
+#include <stddef.h>
+
+#include "rbt_heap.h"
+
+#define RBT_REGION_CHUNK (64 << 10) // default chunk size (in bytes)
+
+// Region data type.
+typedef struct RBT_region {
+    RBT_heap *heap;      // where chunks come from
+    size_t chunk_size;   // number of bytes per chunk
+    void *chunks;        // the current chunk (NULL if there are none)
+    char *top;           // next free byte in the current chunk
+    char *end;           // end of the current chunk
+    size_t num_chunks;   // number of chunks
+    size_t bytes;        // number of bytes allocated since the last reset
+} RBT_region;
+
+// RBT_region_init initializes `region` to allocate from chunks of
+// `chunk_size` bytes (or RBT_REGION_CHUNK, if `chunk_size` is 0) taken from
+// `heap`.
+void RBT_region_init(RBT_region *region, RBT_heap *heap, size_t chunk_size);
+
+// RBT_region_alloc returns a pointer to `size` bytes aligned to
+// RBT_HEAP_ALIGN bytes, or NULL if the heap cannot fit a new chunk. Objects
+// larger than a quarter of a chunk get chunks of their own.
+void *RBT_region_alloc(RBT_region *region, size_t size);
+
+// RBT_region_reset frees every object allocated from `region` by returning
+// all of its chunks to the heap.
+void RBT_region_reset(RBT_region *region);
+
+#endif /* RBT_REGION_H */
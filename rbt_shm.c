@@ -0,0 +1,169 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_shm.c                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_shm.c contains implementations of the functions declared in rbt_shm.h.
+#define _GNU_SOURCE // MAP_FIXED_NOREPLACE
+#include "rbt_shm.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RBT_SHM_MAGIC 0x5242545f73686d31ull // "RBT_shm1"
+
+// helper: Maps `size` bytes of `fd` at exactly `address` (or anywhere, if
+// `address` is NULL, to read the header) without replacing existing mappings.
+// Returns NULL on failure.
+void *RBT_shm_map(int fd, size_t size, void *address) {
+    int flags = MAP_SHARED;
+    #ifdef MAP_FIXED_NOREPLACE
+    if (address != NULL) {
+        flags |= MAP_FIXED_NOREPLACE;
+    }
+    #endif
+    void *mem = mmap(address, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    if (address != NULL && mem != address) { // (the address was only a hint)
+        munmap(mem, size);
+        return NULL;
+    }
+    return mem;
+}
+
+bool RBT_shm_create(RBT_shm *shm, const char *name, size_t size, void *address,
+        RBT_fit fit) {
+    shm->region = NULL;
+    shm->fd = -1;
+    if (size < sizeof(RBT_shm_region) || address == NULL) {
+        return false;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    RBT_shm_region *region = NULL;
+    if (ftruncate(fd, size) != 0 ||
+            (region = RBT_shm_map(fd, size, address)) == NULL) {
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    #ifdef __linux__
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    #endif
+    int failed = pthread_mutex_init(&region->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    char *mem = (char *)region + sizeof(RBT_shm_region);
+    if (failed || !RBT_heap_init(&region->heap, mem, size - sizeof(RBT_shm_region), fit)) {
+        munmap(region, size);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    region->base = region;
+    region->size = size;
+    region->owner_deaths = 0;
+    // last, and with release semantics, so that a process that sees the magic
+    // also sees the rest of the header (and the heap) initialized
+    __atomic_store_n(&region->magic, RBT_SHM_MAGIC, __ATOMIC_RELEASE);
+    shm->region = region;
+    shm->fd = fd;
+    return true;
+}
+
+bool RBT_shm_open(RBT_shm *shm, const char *name) {
+    shm->region = NULL;
+    shm->fd = -1;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // read the header to find the address and size of the region
+    struct stat st;
+    RBT_shm_region *header = NULL;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RBT_shm_region) ||
+            (header = RBT_shm_map(fd, sizeof(RBT_shm_region), NULL)) == NULL) {
+        close(fd);
+        return false;
+    }
+    // (acquire pairs with the creator's release of the magic)
+    bool valid = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == RBT_SHM_MAGIC &&
+            header->size == (size_t)st.st_size;
+    void *base = header->base;
+    size_t size = header->size;
+    munmap(header, sizeof(RBT_shm_region));
+
+    RBT_shm_region *region = valid ? RBT_shm_map(fd, size, base) : NULL;
+    if (region == NULL) {
+        close(fd);
+        return false;
+    }
+    shm->region = region;
+    shm->fd = fd;
+    return true;
+}
+
+void RBT_shm_close(RBT_shm *shm) {
+    if (shm->region == NULL) {
+        return;
+    }
+    munmap(shm->region, shm->region->size);
+    close(shm->fd);
+    shm->region = NULL;
+    shm->fd = -1;
+}
+
+bool RBT_shm_unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+bool RBT_shm_lock(RBT_shm *shm) {
+    int error = pthread_mutex_lock(&shm->region->lock);
+    #ifdef __linux__
+    if (error == EOWNERDEAD) { // the previous owner died holding the lock
+        shm->region->owner_deaths++;
+        error = pthread_mutex_consistent(&shm->region->lock);
+    }
+    #endif
+    return error == 0;
+}
+
+void RBT_shm_unlock(RBT_shm *shm) {
+    pthread_mutex_unlock(&shm->region->lock);
+}
+
+void *RBT_shm_alloc(RBT_shm *shm, size_t size) {
+    if (!RBT_shm_lock(shm)) {
+        return NULL;
+    }
+    void *ptr = RBT_heap_alloc(&shm->region->heap, size);
+    RBT_shm_unlock(shm);
+    return ptr;
+}
+
+void RBT_shm_free(RBT_shm *shm, void *ptr) {
+    if (ptr == NULL || !RBT_shm_lock(shm)) {
+        return;
+    }
+    RBT_heap_free(&shm->region->heap, ptr);
+    RBT_shm_unlock(shm);
+}
+
+size_t RBT_shm_offset(RBT_shm *shm, void *ptr) {
+    return (char *)ptr - (char *)shm->region;
+}
+
+void *RBT_shm_pointer(RBT_shm *shm, size_t offset) {
+    return (char *)shm->region + offset;
+}
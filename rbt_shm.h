@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_shm.h                                                                //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_shm.h contains declarations of functions for a heap (see rbt_heap.h)
+// shared by several processes through a POSIX shared memory object (e.g. in
+// /dev/shm), so that they can exchange buffers without copying them and
+// without a broker process.
+//
+// The shared region starts with a header holding a process-shared mutex and
+// the RBT_heap itself, followed by the heap's memory:
+//
+//   | header (mutex, heap, ...) | blocks ...                              |
+//   ^ base
+//
+// Tree links and block pointers are stored as plain addresses, so every
+// process maps the region at the same address (`base`, recorded in the
+// header). That address is fixed by the creator rather than chosen by the
+// system, since an address from the creator's (randomized) layout may be in
+// use in an unrelated process: use RBT_SHM_BASE, or another address high in
+// the address space, with no overlap between the heaps a process opens. Buffers are
+// passed between processes as offsets from `base` (see RBT_shm_offset and
+// RBT_shm_pointer).
+//
+// The mutex is robust (on Linux): if a process dies while holding it, the next
+// process to lock it takes it over and `owner_deaths` is incremented. A heap
+// operation interrupted this way may have left the heap inconsistent, which
+// can be checked with RBT_heap_ok while holding the lock.
+
+#ifndef RBT_SHM_H
+#define RBT_SHM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "rbt_heap.h"
+
+// Default address of a shared region: above the program, its heap and the
+// stacks of threads, and below the libraries and stack (on 64-bit Linux with
+// a 47-bit or larger address space).
+#define RBT_SHM_BASE ((void *)0x600000000000ull)
+
+// Header of a shared region.
+typedef struct RBT_shm_region {
+    unsigned long long magic;  // identifies an initialized region
+    void *base;                // address of the region in every process
+    size_t size;               // size of the region (in bytes)
+    pthread_mutex_t lock;      // guards `heap`
+    unsigned int owner_deaths; // times the lock was taken from a dead process
+    RBT_heap heap;             // the heap, managing the rest of the region
+} RBT_shm_region;
+
+// A process's view of a shared heap.
+typedef struct RBT_shm {
+    RBT_shm_region *region; // the mapped region (NULL if not open)
+    int fd;                 // file descriptor of the shared memory object
+} RBT_shm;
+
+// RBT_shm_create creates the shared memory object `name` (which must not
+// exist), maps `size` bytes of it at `address` (e.g. RBT_SHM_BASE) and
+// initializes a heap in it with the given placement policy. Returns false if
+// `address` is NULL or already in use, or if any other step fails.
+bool RBT_shm_create(RBT_shm *shm, const char *name, size_t size, void *address,
+        RBT_fit fit);
+
+// RBT_shm_open maps the existing shared heap `name` at the address it was
+// created with. Returns false if it does not exist, is not a shared heap, or
+// if that address is already in use in this process.
+bool RBT_shm_open(RBT_shm *shm, const char *name);
+
+// RBT_shm_close unmaps a shared heap from this process (the heap remains
+// available to other processes).
+void RBT_shm_close(RBT_shm *shm);
+
+// RBT_shm_unlink removes the name of a shared heap. Its memory is released
+// once every process has closed it. Returns false if it cannot be removed.
+bool RBT_shm_unlink(const char *name);
+
+// RBT_shm_lock locks the heap (for operations on shm->region->heap). Returns
+// false if the lock is unrecoverable.
+bool RBT_shm_lock(RBT_shm *shm);
+
+// RBT_shm_unlock unlocks the heap.
+void RBT_shm_unlock(RBT_shm *shm);
+
+// RBT_shm_alloc allocates `size` bytes from the shared heap (see
+// RBT_heap_alloc). Returns NULL if no free block is large enough.
+void *RBT_shm_alloc(RBT_shm *shm, size_t size);
+
+// RBT_shm_free returns the memory at `ptr` (which must have been returned by
+// RBT_shm_alloc on the same shared heap, possibly in another process) to the
+// heap. Does nothing if `ptr` is NULL.
+void RBT_shm_free(RBT_shm *shm, void *ptr);
+
+// RBT_shm_offset returns the offset of `ptr` in the shared region, which is
+// the same in every process.
+size_t RBT_shm_offset(RBT_shm *shm, void *ptr);
+
+// RBT_shm_pointer returns the address of the given offset in the shared
+// region (see RBT_shm_offset).
+void *RBT_shm_pointer(RBT_shm *shm, size_t offset);
+
+#endif /* RBT_SHM_H */
@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_slab.c                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_slab.c contains implementations of the functions declared in
+// rbt_slab.h.
+#include "rbt_slab.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#define RBT_SLAB_ERROR "\033[31;1mError: \033[0m"
+
+// Offset of the first slot (the header, rounded up to RBT_HEAP_ALIGN).
+#define SLOTS_OFFSET \
+    ((sizeof(RBT_slab) + RBT_HEAP_ALIGN - 1) & ~(size_t)(RBT_HEAP_ALIGN - 1))
+
+// helper: Returns the address of slot `i` of `slab`.
+char *RBT_slab_slot(RBT_slab_cache *cache, RBT_slab *slab, unsigned int i) {
+    return (char *)slab + SLOTS_OFFSET + i * cache->object_size;
+}
+
+// helper: Inserts `slab` at the front of the list `*list`.
+void RBT_slab_push(RBT_slab **list, RBT_slab *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+// helper: Removes `slab` from the list `*list`.
+void RBT_slab_unlink(RBT_slab **list, RBT_slab *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+// helper: Allocates a new slab from the heap and adds it to the partial
+// slabs. Returns NULL if the heap cannot fit it.
+RBT_slab *RBT_slab_new(RBT_slab_cache *cache) {
+    // the block (not its payload) starts at a multiple of RBT_SLAB_SIZE and
+    // is RBT_SLAB_SIZE bytes long, so the next slab may start where it ends
+    // (and its capacity is not rounded to a size class)
+    RBT_heap *heap = cache->heap;
+    unsigned int class_bits = heap->class_bits;
+    heap->class_bits = 0;
+    RBT_slab *slab = RBT_heap_alloc_aligned_at(heap, RBT_SLAB_SIZE - heap->header_size,
+            RBT_SLAB_SIZE, cache->offset);
+    heap->class_bits = class_bits;
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->used = 0;
+    slab->hint = 0;
+    memset(slab->bitmap, 0, sizeof(slab->bitmap));
+    // mark the bits past the last slot (in its word) as in use
+    if (cache->slots % 64 != 0) {
+        slab->bitmap[cache->slots / 64] = UINT64_MAX << (cache->slots % 64);
+    }
+    RBT_slab_push(&cache->partial, slab);
+    cache->num_slabs++;
+    return slab;
+}
+
+bool RBT_slab_cache_init(RBT_slab_cache *cache, RBT_heap *heap, size_t object_size) {
+    if (object_size == 0 || object_size > RBT_SLAB_MAX_OBJECT) {
+        return false;
+    }
+    cache->heap = heap;
+    cache->object_size = (object_size + RBT_HEAP_ALIGN - 1) & ~(size_t)(RBT_HEAP_ALIGN - 1);
+    // (the payload after a split header starts at the next RBT_HEAP_ALIGN)
+    cache->offset = (heap->header_size + RBT_HEAP_ALIGN - 1) & ~(size_t)(RBT_HEAP_ALIGN - 1);
+    cache->slots = (RBT_SLAB_SIZE - cache->offset - SLOTS_OFFSET) / cache->object_size;
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->num_slabs = 0;
+    return true;
+}
+
+void RBT_slab_cache_destroy(RBT_slab_cache *cache) {
+    RBT_slab *lists[] = {cache->partial, cache->full};
+    for (int i = 0; i < 2; i++) {
+        RBT_slab *slab = lists[i];
+        while (slab != NULL) {
+            RBT_slab *next = slab->next;
+            RBT_heap_free(cache->heap, slab);
+            slab = next;
+        }
+    }
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->num_slabs = 0;
+}
+
+void *RBT_slab_alloc(RBT_slab_cache *cache) {
+    RBT_slab *slab = cache->partial;
+    if (slab == NULL && (slab = RBT_slab_new(cache)) == NULL) {
+        return NULL;
+    }
+    // find a free slot, starting from the hint
+    unsigned int words = (cache->slots + 63) / 64;
+    unsigned int w = slab->hint;
+    while (slab->bitmap[w] == UINT64_MAX) {
+        w = w + 1 == words ? 0 : w + 1;
+    }
+    unsigned int i = 64 * w + __builtin_ctzll(~slab->bitmap[w]);
+    slab->bitmap[w] |= 1ull << (i % 64);
+    slab->hint = w;
+    slab->used++;
+    if (slab->used == cache->slots) {
+        RBT_slab_unlink(&cache->partial, slab);
+        RBT_slab_push(&cache->full, slab);
+    }
+    return RBT_slab_slot(cache, slab, i);
+}
+
+void RBT_slab_free(RBT_slab_cache *cache, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    RBT_slab *slab = (RBT_slab *)(((uintptr_t)ptr & ~(uintptr_t)(RBT_SLAB_SIZE - 1)) +
+            cache->offset);
+    size_t offset = (char *)ptr - RBT_slab_slot(cache, slab, 0);
+    unsigned int i = offset / cache->object_size;
+    uint64_t bit = 1ull << (i % 64);
+    if (offset % cache->object_size != 0 || i >= cache->slots ||
+            (slab->bitmap[i / 64] & bit) == 0) {
+        printf(RBT_SLAB_ERROR "%p is not an allocated object\n", ptr);
+        raise(SIGABRT);
+    }
+    slab->bitmap[i / 64] &= ~bit;
+    slab->hint = i / 64;
+    if (slab->used == cache->slots) {
+        RBT_slab_unlink(&cache->full, slab);
+        RBT_slab_push(&cache->partial, slab);
+    }
+    slab->used--;
+    // return an empty slab to the heap, unless it is the last one
+    if (slab->used == 0 && cache->num_slabs > 1) {
+        RBT_slab_unlink(&cache->partial, slab);
+        RBT_heap_free(cache->heap, slab);
+        cache->num_slabs--;
+    }
+}
@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_slab.h                                                               //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_slab.h contains declarations of functions for slab caches: allocators
+// of objects of one fixed size, carved from large chunks ("slabs") of a heap
+// (see rbt_heap.h).
+//
+// Objects allocated from a slab cache never enter the heap's RBT, so churn
+// of small fixed-size objects neither searches the tree nor leaves long lists
+// of duplicates in it. Each slab is a heap block of RBT_SLAB_SIZE bytes
+// (including the heap's block header), placed at a multiple of its size, so
+// that slabs tile the heap without gaps. The slab itself starts with a
+// header holding a bitmap of its slots:
+//
+//   | block header | slab header (bitmap, ...) | slot 0 | ... | slot n-1 |
+//   ^ RBT_SLAB_SIZE-aligned
+//
+// so the slab of an object is found by rounding its address down (and
+// skipping the block header). A slab is returned to the heap as soon as all
+// of its objects are freed (unless it is the cache's last slab).
+
+#ifndef RBT_SLAB_H
+#define RBT_SLAB_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rbt_heap.h"
+
+#define RBT_SLAB_SIZE (64 << 10) // size (and alignment) of a slab in bytes
+
+// Largest number of slots in a slab (one per RBT_HEAP_ALIGN bytes).
+#define RBT_SLAB_MAX_SLOTS (RBT_SLAB_SIZE / RBT_HEAP_ALIGN)
+
+// Largest object size (so that every slab holds at least 8 objects).
+#define RBT_SLAB_MAX_OBJECT (RBT_SLAB_SIZE / 16)
+
+// Header of a slab.
+typedef struct RBT_slab {
+    struct RBT_slab *prev; // neighbors in the cache's list of slabs
+    struct RBT_slab *next;
+    unsigned int used;     // number of slots in use
+    unsigned int hint;     // index of a bitmap word that may have a free slot
+    uint64_t bitmap[RBT_SLAB_MAX_SLOTS / 64]; // bit i is set if slot i is in use
+} RBT_slab;
+
+// Slab cache data type.
+typedef struct RBT_slab_cache {
+    RBT_heap *heap;        // where slabs come from
+    size_t object_size;    // size of every slot (in bytes)
+    size_t offset;         // offset of each slab from its RBT_SLAB_SIZE boundary
+    unsigned int slots;    // number of slots per slab
+    RBT_slab *partial;     // slabs with free slots
+    RBT_slab *full;        // slabs without free slots
+    size_t num_slabs;      // number of slabs
+} RBT_slab_cache;
+
+// RBT_slab_cache_init initializes `cache` to allocate objects of
+// `object_size` bytes (rounded up to a multiple of RBT_HEAP_ALIGN) from slabs
+// of `heap`. Returns false if `object_size` is 0 or more than
+// RBT_SLAB_MAX_OBJECT.
+bool RBT_slab_cache_init(RBT_slab_cache *cache, RBT_heap *heap, size_t object_size);
+
+// RBT_slab_cache_destroy returns every slab of `cache` to its heap (freeing
+// any objects still allocated from it).
+void RBT_slab_cache_destroy(RBT_slab_cache *cache);
+
+// RBT_slab_alloc returns a pointer to an object from `cache` (aligned to
+// RBT_HEAP_ALIGN bytes), or NULL if no slot is free and the heap cannot fit
+// a new slab.
+void *RBT_slab_alloc(RBT_slab_cache *cache);
+
+// RBT_slab_free returns the object at `ptr` (which must have been returned by
+// RBT_slab_alloc on the same cache) to its slab. Raises SIGABRT if it is not
+// allocated. Does nothing if `ptr` is NULL.
+void RBT_slab_free(RBT_slab_cache *cache, void *ptr);
+
+#endif /* RBT_SLAB_H */
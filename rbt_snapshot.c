@@ -0,0 +1,130 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_snapshot.c                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_snapshot.c contains implementations of the functions declared in
+// rbt_snapshot.h.
+#include "rbt_snapshot.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define CACHE_LINE 64 // alignment (in bytes) of the capacities
+
+// The number of capacities per cache line. Prefetching position 16k fetches
+// the descendants of k that are 4 levels down.
+#define PER_LINE (CACHE_LINE / sizeof(unsigned int))
+
+// helper: Copies the sorted `capacities` and `at_least` counts into the
+// Eytzinger positions of the subtree rooted at position `k`, starting with
+// the i-th sorted capacity. Returns the index of the next sorted capacity.
+size_t RBT_snapshot_fill(RBT_snapshot snapshot, const unsigned int *capacities,
+        const size_t *at_least, size_t i, size_t k) {
+    if (k > snapshot->size) {
+        return i;
+    }
+    i = RBT_snapshot_fill(snapshot, capacities, at_least, i, 2 * k);
+    snapshot->capacities[k] = capacities[i];
+    snapshot->at_least[k] = at_least[i];
+    i++;
+    return RBT_snapshot_fill(snapshot, capacities, at_least, i, 2 * k + 1);
+}
+
+// helper: Returns the number of bytes needed for `n` capacities (plus the
+// unused position 0), rounded up to a whole number of cache lines.
+size_t RBT_snapshot_capacities_size(size_t n) {
+    size_t size = (n + 1) * sizeof(unsigned int);
+    return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+RBT_snapshot RBT_snapshot_new(RBT root) {
+    RBT_snapshot snapshot = calloc(1, sizeof(struct RBT_snapshot));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+
+    // count the distinct capacities
+    RBT_cursor cursor;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next(&cursor)) {
+        snapshot->size++;
+    }
+
+    // collect them in sorted order, along with the number of each
+    size_t n = snapshot->size;
+    unsigned int *capacities = malloc((n + 1) * sizeof(unsigned int));
+    size_t *at_least = malloc((n + 1) * sizeof(size_t));
+    snapshot->capacities = aligned_alloc(CACHE_LINE, RBT_snapshot_capacities_size(n));
+    snapshot->at_least = malloc((n + 1) * sizeof(size_t));
+    if (capacities == NULL || at_least == NULL ||
+            snapshot->capacities == NULL || snapshot->at_least == NULL) {
+        free(capacities);
+        free(at_least);
+        RBT_snapshot_free(snapshot);
+        return NULL;
+    }
+    size_t i = 0;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next(&cursor)) {
+        size_t count = 0;
+        for (RBT block = node; block != NULL; block = block->next) {
+            count++;
+        }
+        capacities[i] = node->capacity;
+        at_least[i] = count;
+        snapshot->blocks += count;
+        snapshot->bytes += (unsigned long long)count * node->capacity;
+        i++;
+    }
+    // turn the counts into the number of blocks of at least each capacity
+    for (i = n; i-- > 1; ) {
+        at_least[i - 1] += at_least[i];
+    }
+
+    snapshot->capacities[0] = 0;
+    snapshot->at_least[0] = 0;
+    RBT_snapshot_fill(snapshot, capacities, at_least, 0, 1);
+    free(capacities);
+    free(at_least);
+    return snapshot;
+}
+
+void RBT_snapshot_free(RBT_snapshot snapshot) {
+    if (snapshot == NULL) {
+        return;
+    }
+    free(snapshot->capacities);
+    free(snapshot->at_least);
+    free(snapshot);
+}
+
+// helper: Returns the Eytzinger position of the smallest capacity that is at
+// least that requested, or 0 if there is none.
+//
+// The search descends to the left child when a capacity is large enough and
+// to the right otherwise, appending one bit to `k` per level, until it falls
+// off the bottom of the tree. The last position at which it went left is the
+// answer: it is found by removing the trailing 1 bits (right turns) and the
+// 0 bit (left turn) before them.
+size_t RBT_snapshot_search(RBT_snapshot snapshot, unsigned int capacity) {
+    const unsigned int *capacities = snapshot->capacities;
+    size_t n = snapshot->size;
+    size_t k = 1;
+    while (k <= n) {
+        __builtin_prefetch(capacities + PER_LINE * k);
+        k = 2 * k + (capacities[k] < capacity);
+    }
+    return k >> __builtin_ffsll(~k);
+}
+
+unsigned int RBT_snapshot_lower_bound(RBT_snapshot snapshot, unsigned int capacity) {
+    return snapshot->capacities[RBT_snapshot_search(snapshot, capacity)];
+}
+
+bool RBT_snapshot_has_at_least(RBT_snapshot snapshot, unsigned int capacity) {
+    return RBT_snapshot_search(snapshot, capacity) != 0;
+}
+
+size_t RBT_snapshot_count_at_least(RBT_snapshot snapshot, unsigned int capacity) {
+    return snapshot->at_least[RBT_snapshot_search(snapshot, capacity)];
+}
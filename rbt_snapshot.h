@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// rbt_snapshot.h                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// rbt_snapshot.h contains declarations of functions for read-only snapshots
+// of the capacities in an RBT, for answering monitoring queries (e.g. "is
+// there a free block of at least N bytes?") without touching the live tree.
+//
+// A snapshot stores the distinct capacities of the tree in Eytzinger (BFS)
+// order: the root of an implicit, perfectly balanced search tree is at
+// position 1, and the children of position k are at 2k and 2k + 1. Searches
+// are branch-free and read memory in a predictable pattern, so the next few
+// levels can be prefetched while the current one is compared.
+//
+// A snapshot is immutable once built, so any number of threads may query it
+// concurrently. Building a snapshot reads the tree, so it must be done by the
+// thread that owns the tree (or while holding its lock); the snapshot can then
+// be published to other threads (e.g. through an atomic pointer) and freed
+// once no thread uses it.
+
+#ifndef RBT_SNAPSHOT_H
+#define RBT_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rbt.h"
+
+// Snapshot data type.
+typedef struct RBT_snapshot {
+    size_t size;              // number of distinct capacities
+    size_t blocks;            // number of blocks (including duplicates)
+    unsigned long long bytes; // sum of the capacities of all blocks
+    unsigned int *capacities; // distinct capacities, in Eytzinger order
+    size_t *at_least;         // number of blocks of at least each capacity
+} *RBT_snapshot;
+
+// RBT_snapshot_new returns a snapshot of the capacities in the RBT `root`, or
+// NULL if memory for it cannot be allocated. Runs in O(n) time.
+RBT_snapshot RBT_snapshot_new(RBT root);
+
+// RBT_snapshot_free frees a snapshot. Does nothing if `snapshot` is NULL.
+void RBT_snapshot_free(RBT_snapshot snapshot);
+
+// RBT_snapshot_lower_bound returns the smallest capacity in the snapshot that
+// is at least that requested, or 0 if there is none.
+unsigned int RBT_snapshot_lower_bound(RBT_snapshot snapshot, unsigned int capacity);
+
+// RBT_snapshot_has_at_least returns whether the snapshot contains a block of
+// at least the given capacity.
+bool RBT_snapshot_has_at_least(RBT_snapshot snapshot, unsigned int capacity);
+
+// RBT_snapshot_count_at_least returns the number of blocks in the snapshot of
+// at least the given capacity. The number of blocks with capacities in
+// [low, high) is count_at_least(low) - count_at_least(high).
+size_t RBT_snapshot_count_at_least(RBT_snapshot snapshot, unsigned int capacity);
+
+#endif /* RBT_SNAPSHOT_H */
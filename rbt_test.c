@@ -1,4 +1,18 @@
 #include "rbt.h"
+#include "bpt.h"
+#include "rbt_fit.h"
+#include "rbt_heap.h"
+#include "rbt_snapshot.h"
+#include "rbt_mru.h"
+#include "rbt_hash.h"
+#include "rbt_parallel.h"
+#include "rbt_shm.h"
+#include "rbt_numa.h"
+#include "rbt_slab.h"
+#include "rbt_region.h"
+#include "rbt_handle.h"
+#include "rbt_profile.h"
+#include "wavl.h"
 
 #include <stdio.h>
 #include <stdbool.h>
@@ -6,10 +20,32 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #define ERROR "\033[31;1mError: \033[0m"
 #define DOUBLE_WORD_SIZE (sizeof(long))
 
+#define HEAP_SIZE (1 << 20) // number of bytes in each tested heap
+#define HEAP_PTRS 512       // number of live allocations in each tested heap
+#define HUGE_HEAP_SIZE ((size_t)3 << 29) // number of bytes in the tested heap over 1 GiB
+
+#define BPT_BLOCKS 5000 // number of blocks in the tested BPT
+#define WAVL_BLOCKS 3000 // number of blocks in the tested WAVL trees
+#define MRU_BLOCKS 3000  // number of blocks in the tested MRU-cached tree
+#define HASH_BLOCKS 3000 // number of blocks in the tested hash-indexed tree
+#define PARALLEL_BLOCKS 20000 // number of blocks in trees built in parallel
+#define SHM_SIZE (1 << 20)    // number of bytes in the tested shared heap
+#define NUMA_SIZE (1 << 20)   // number of bytes in each tested NUMA arena
+#define SLAB_HEAP_SIZE (4 << 20) // number of bytes in the heap of the tested slabs
+#define SLAB_OBJECTS 5000        // number of objects allocated from slabs
+#define REGION_OBJECTS 20000     // number of objects allocated from regions
+#define REGION_CHUNKS 200        // number of adjacent chunks returned at once by a reset
+#define HANDLE_OBJECTS 5000      // number of relocatable objects in the tested heap
+#define PROFILE_OBJECTS 400      // number of objects allocated from profiled sites
+#define PROFILE_CHURN 200000     // number of 1 KiB allocations sampled at the default rate
+
 void bst_tests() {
     ////////////////////////////////////////////////////////////////////
     // Insert and free 100 of the same value into the root's linked list
@@ -21,6 +57,11 @@ void bst_tests() {
             exit(1);
         }
     }
+    if (RBT_count(tree) != 101) {
+        printf(ERROR "101 nodes should share the capacity 100 (not %zu)\n",
+                RBT_count(tree));
+        exit(1);
+    }
     #ifdef ALLOC_TRACK
     unsigned int num_allocated = RBT_num_nodes();
     printf("%d nodes allocated", num_allocated);
@@ -612,8 +653,1568 @@ void rbt_insertion_test_2() {
     }
 }
 
+// Check that RBT_remove_good_fit always returns a node that is either within
+// the requested slack or the best fit (when no node within the slack lies on
+// the search path).
+void good_fit_tests() {
+    unsigned int counts[200] = {0};
+    RBT tree = NULL;
+    for (unsigned int i = 0; i < 10000; i++) {
+        unsigned int next_val = rand() % 200;
+        tree = RBT_add(tree, malloc(sizeof(struct RBT)), next_val);
+        counts[next_val]++;
+    }
+
+    RBT removed;
+    tree = RBT_remove_good_fit(tree, 200, 1000, &removed);
+    if (removed != NULL) {
+        printf(ERROR "no node should be at least 200\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < 10000; i++) {
+        unsigned int requested = rand() % 200;
+        unsigned int slack = rand() % 3 == 0 ? 0 : RBT_percent_slack(requested, 25);
+        tree = RBT_remove_good_fit(tree, requested, slack, &removed);
+
+        unsigned int best = requested;
+        while (best < 200 && counts[best] == 0) {
+            best++;
+        }
+        if (best == 200) {
+            if (removed != NULL) {
+                printf(ERROR "no node should be at least %u\n", requested);
+                exit(1);
+            }
+            continue;
+        }
+        if (removed == NULL) {
+            printf(ERROR "a node should have been removed\n");
+            exit(1);
+        }
+        unsigned int c = removed->capacity;
+        if (c < requested || (c > requested + slack && c != best)) {
+            printf(ERROR "requested %u (slack %u) but got %u (best: %u)\n",
+                    requested, slack, c, best);
+            exit(1);
+        }
+        if (slack == 0 && c != best) {
+            printf(ERROR "requested %u (slack 0) but got %u (best: %u)\n",
+                    requested, c, best);
+            exit(1);
+        }
+        counts[c]--;
+        RBT_free(removed);
+    }
+    RBT_free(tree);
+}
+
+// Check that cursors visit every node in order, and that seeking finds the
+// smallest capacity that is at least that requested.
+void cursor_tests() {
+    unsigned int counts[1000] = {0};
+    RBT tree = NULL;
+    RBT_cursor cursor;
+    if (RBT_cursor_first(&cursor, tree) != NULL ||
+            RBT_cursor_next_block(&cursor) != NULL) {
+        printf(ERROR "cursor over an empty tree should be done\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < 10000; i++) {
+        unsigned int next_val = rand() % 1000;
+        tree = RBT_add(tree, malloc(sizeof(struct RBT)), next_val);
+        counts[next_val]++;
+    }
+
+    // visit every block
+    unsigned int visited[1000] = {0};
+    unsigned int prev = 0;
+    for (RBT node = RBT_cursor_first(&cursor, tree); node != NULL;
+            node = RBT_cursor_next_block(&cursor)) {
+        if (node->capacity < prev) {
+            printf(ERROR "cursor visited %u after %u\n", node->capacity, prev);
+            exit(1);
+        }
+        prev = node->capacity;
+        visited[node->capacity]++;
+    }
+    if (memcmp(visited, counts, sizeof(counts)) != 0) {
+        printf(ERROR "cursor should visit every block exactly once\n");
+        exit(1);
+    }
+
+    // visit every distinct capacity from a random starting point
+    for (unsigned int i = 0; i < 100; i++) {
+        unsigned int requested = rand() % 1001;
+        unsigned int expected = requested;
+        RBT node = RBT_cursor_seek_at_least(&cursor, tree, requested);
+        while (node != NULL) {
+            while (counts[expected] == 0) {
+                expected++;
+            }
+            if (node->capacity != expected) {
+                printf(ERROR "cursor found %u (expected %u)\n",
+                        node->capacity, expected);
+                exit(1);
+            }
+            expected++;
+            node = RBT_cursor_next(&cursor);
+        }
+        while (expected < 1000 && counts[expected] == 0) {
+            expected++;
+        }
+        if (expected < 1000) {
+            printf(ERROR "cursor stopped before %u\n", expected);
+            exit(1);
+        }
+    }
+    RBT_free(tree);
+}
+
+// helper: RBT_destroy callback that counts the nodes it is passed.
+void count_node(void *context, RBT node) {
+    (*(unsigned int *)context)++;
+}
+
+// helper: RBT_allocator batch callback that counts the nodes it is passed
+// and checks the batch size.
+void count_batch(void *context, RBT *nodes, size_t count) {
+    if (count == 0 || count > RBT_FREE_BATCH) {
+        printf(ERROR "batch of %zu nodes\n", count);
+        exit(1);
+    }
+    for (size_t i = 0; i < count; i++) {
+        count_node(context, nodes[i]);
+    }
+}
+
+// Check that RBT_destroy and the allocator hooks visit every node (including
+// duplicates) and that RBT_forget empties a tree whose nodes live in a single allocation.
+void destroy_tests() {
+    struct RBT *arena = malloc(20000 * sizeof(struct RBT));
+    RBT tree = NULL;
+    for (unsigned int i = 0; i < 20000; i++) {
+        tree = RBT_add(tree, &arena[i], rand() % 1000);
+    }
+    unsigned int count = 0;
+    RBT_destroy(tree, &count_node, &count);
+    if (count != 20000) {
+        printf(ERROR "RBT_destroy visited %u nodes (expected 20000)\n", count);
+        exit(1);
+    }
+
+    RBT_allocator allocators[] = {
+        {&count, &count_node, NULL},
+        {&count, NULL, &count_batch},
+    };
+    for (int i = 0; i < 2; i++) {
+        tree = NULL;
+        for (unsigned int j = 0; j < 20000; j++) {
+            tree = RBT_add(tree, &arena[j], rand() % 1000);
+        }
+        count = 0;
+        RBT_free_with(tree, &allocators[i]);
+        if (count != 20000) {
+            printf(ERROR "RBT_free_with freed %u nodes (expected 20000)\n", count);
+            exit(1);
+        }
+
+        tree = NULL;
+        for (unsigned int j = 0; j < 1000; j++) {
+            tree = RBT_add(tree, &arena[j], 10);
+        }
+        count = 0;
+        RBT_free_list_with(tree, &allocators[i]);
+        if (count != 1000) {
+            printf(ERROR "RBT_free_list_with freed %u nodes (expected 1000)\n", count);
+            exit(1);
+        }
+    }
+
+    tree = NULL;
+    for (unsigned int i = 0; i < 20000; i++) {
+        tree = RBT_add(tree, &arena[i], i % 1000); // ascending
+    }
+    if ((tree = RBT_forget(tree)) != NULL) {
+        printf(ERROR "RBT_forget should return an empty tree\n");
+        exit(1);
+    }
+    free(arena);
+}
+
+// Check that a BPT removes the same capacities as an RBT would (the best fit)
+// and that specific blocks can be removed from it.
+void bpt_tests() {
+    unsigned int counts[3000] = {0};
+    RBT blocks = malloc(BPT_BLOCKS * sizeof(struct RBT));
+    bool in_tree[BPT_BLOCKS] = {false};
+    BPT tree = NULL;
+
+    RBT removed;
+    tree = BPT_remove_at_least(tree, 0, &removed);
+    if (tree != NULL || removed != NULL) {
+        printf(ERROR "empty BPT should remain empty\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < BPT_BLOCKS; i++) {
+        unsigned int next_val = rand() % 3000;
+        tree = BPT_add(tree, &blocks[i], next_val);
+        in_tree[i] = true;
+        counts[next_val]++;
+    }
+    if (BPT_height(tree) < 2) {
+        printf(ERROR "BPT should have grown to at least 2 levels\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < BPT_BLOCKS; i++) {
+        if (rand() % 2 == 0) { // remove a specific block
+            unsigned int j = rand() % BPT_BLOCKS;
+            tree = BPT_remove_node(tree, &blocks[j], &removed);
+            if (removed != (in_tree[j] ? &blocks[j] : NULL)) {
+                printf(ERROR "BPT_remove_node removed the wrong block\n");
+                exit(1);
+            }
+            if (removed != NULL) {
+                in_tree[j] = false;
+                counts[removed->capacity]--;
+            }
+            continue;
+        }
+        unsigned int requested = rand() % 3100;
+        unsigned int best = requested < 3000 ? requested : 3000;
+        while (best < 3000 && counts[best] == 0) {
+            best++;
+        }
+        tree = BPT_remove_at_least(tree, requested, &removed);
+        if (best == 3000 ? removed != NULL :
+                (removed == NULL || removed->capacity != best)) {
+            printf(ERROR "BPT_remove_at_least(%u) should remove %u\n",
+                    requested, best);
+            exit(1);
+        }
+        if (removed != NULL) {
+            if (removed->next != NULL) {
+                printf(ERROR "removed blocks should be detached\n");
+                exit(1);
+            }
+            in_tree[removed - blocks] = false;
+            counts[best]--;
+        }
+    }
+
+    // remove everything that is left
+    for (unsigned int i = 0; i < BPT_BLOCKS; i++) {
+        if (in_tree[i]) {
+            tree = BPT_remove_node(tree, &blocks[i], &removed);
+            if (removed != &blocks[i]) {
+                printf(ERROR "BPT_remove_node should remove every block\n");
+                exit(1);
+            }
+        }
+    }
+    if (tree != NULL) {
+        printf(ERROR "BPT should be empty\n");
+        exit(1);
+    }
+
+    // forgetting the blocks (without a dealloc) still accounts for them
+    unsigned int num_allocated = RBT_num_nodes();
+    for (unsigned int i = 0; i < BPT_BLOCKS; i++) {
+        tree = BPT_add(tree, &blocks[i], rand() % 3000);
+    }
+    BPT_destroy(tree, NULL, NULL);
+    if (RBT_num_nodes() != num_allocated) {
+        printf(ERROR "BPT_destroy should forget %d blocks\n", BPT_BLOCKS);
+        exit(1);
+    }
+    free(blocks);
+}
+
+// helper: Exits unless RBT_count returns counts[c] for the tree node of every
+// capacity c in `root`.
+void counts_ok(RBT root, const unsigned int *counts) {
+    RBT_cursor cursor;
+    for (RBT node = RBT_cursor_first(&cursor, root); node != NULL;
+            node = RBT_cursor_next(&cursor)) {
+        if (RBT_count(node) != counts[node->capacity]) {
+            printf(ERROR "capacity %u has count %zu (expected %u)\n",
+                    node->capacity, RBT_count(node), counts[node->capacity]);
+            exit(1);
+        }
+    }
+}
+
+// Check WAVL trees against reference counts of each capacity, the same way as
+// bpt_tests.
+void wavl_tests() {
+    RBT blocks = malloc(WAVL_BLOCKS * sizeof(struct RBT));
+    bool in_tree[WAVL_BLOCKS] = {false};
+    unsigned int counts[1000] = {0};
+    RBT tree = NULL;
+    RBT removed;
+
+    // ascending insertions build an AVL tree (height <= 1.44 * log2(n))
+    for (unsigned int i = 0; i < WAVL_BLOCKS; i++) {
+        tree = WAVL_add(tree, &blocks[i], i);
+    }
+    if (RBT_height(tree) > 17) {
+        printf(ERROR "WAVL tree of %d ascending nodes has height %d\n",
+                WAVL_BLOCKS, RBT_height(tree));
+        exit(1);
+    }
+    for (unsigned int i = 0; i < WAVL_BLOCKS; i++) {
+        tree = WAVL_remove_at_least(tree, 0, &removed);
+        if (removed != &blocks[i]) {
+            printf(ERROR "WAVL_remove_at_least(0) should remove %u\n", i);
+            exit(1);
+        }
+    }
+    if (tree != NULL) {
+        printf(ERROR "WAVL tree should be empty\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < WAVL_BLOCKS; i++) {
+        unsigned int next_val = rand() % 1000;
+        tree = WAVL_add(tree, &blocks[i], next_val);
+        in_tree[i] = true;
+        counts[next_val]++;
+    }
+    for (unsigned int i = 0; i < 2 * WAVL_BLOCKS; i++) {
+        if (rand() % 3 == 0) { // put a removed block back
+            unsigned int j = rand() % WAVL_BLOCKS;
+            if (!in_tree[j]) {
+                unsigned int next_val = rand() % 1000;
+                tree = WAVL_add(tree, &blocks[j], next_val);
+                in_tree[j] = true;
+                counts[next_val]++;
+            }
+        } else if (rand() % 2 == 0) { // remove a specific block
+            unsigned int j = rand() % WAVL_BLOCKS;
+            tree = WAVL_remove_node(tree, &blocks[j], &removed);
+            if (removed != (in_tree[j] ? &blocks[j] : NULL)) {
+                printf(ERROR "WAVL_remove_node removed the wrong block\n");
+                exit(1);
+            }
+            if (removed != NULL) {
+                in_tree[j] = false;
+                counts[removed->capacity]--;
+            }
+        } else {
+            unsigned int requested = rand() % 1100;
+            unsigned int best = requested < 1000 ? requested : 1000;
+            while (best < 1000 && counts[best] == 0) {
+                best++;
+            }
+            tree = WAVL_remove_at_least(tree, requested, &removed);
+            if (best == 1000 ? removed != NULL :
+                    (removed == NULL || removed->capacity != best)) {
+                printf(ERROR "WAVL_remove_at_least(%u) should remove %u\n",
+                        requested, best);
+                exit(1);
+            }
+            if (removed != NULL) {
+                if (removed->next != NULL || removed->left != NULL ||
+                        removed->right != NULL) {
+                    printf(ERROR "removed blocks should be detached\n");
+                    exit(1);
+                }
+                in_tree[removed - blocks] = false;
+                counts[best]--;
+            }
+        }
+        counts_ok(tree, counts);
+    }
+
+    // remove everything that is left
+    for (unsigned int i = 0; i < WAVL_BLOCKS; i++) {
+        if (in_tree[i]) {
+            tree = WAVL_remove_node(tree, &blocks[i], &removed);
+            if (removed != &blocks[i]) {
+                printf(ERROR "WAVL_remove_node should remove every block\n");
+                exit(1);
+            }
+        }
+    }
+    if (tree != NULL) {
+        printf(ERROR "WAVL tree should be empty\n");
+        exit(1);
+    }
+    free(blocks);
+}
+
+// Check that snapshot queries match the tree the snapshot was taken of.
+void snapshot_tests() {
+    RBT_snapshot snapshot = RBT_snapshot_new(NULL);
+    if (snapshot == NULL || RBT_snapshot_has_at_least(snapshot, 0) ||
+            RBT_snapshot_count_at_least(snapshot, 0) != 0) {
+        printf(ERROR "snapshot of an empty tree should be empty\n");
+        exit(1);
+    }
+    RBT_snapshot_free(snapshot);
+
+    for (unsigned int size = 1; size <= 1000; size *= 10) {
+        size_t counts[1002] = {0};
+        RBT tree = NULL;
+        for (unsigned int i = 0; i < 2 * size; i++) {
+            unsigned int next_val = 1 + rand() % size;
+            tree = RBT_add(tree, malloc(sizeof(struct RBT)), next_val);
+            counts[next_val]++;
+        }
+        snapshot = RBT_snapshot_new(tree);
+        if (snapshot->blocks != 2 * size) {
+            printf(ERROR "snapshot has %zu blocks (expected %u)\n",
+                    snapshot->blocks, 2 * size);
+            exit(1);
+        }
+        size_t at_least = 0;
+        unsigned int lower_bound = 0;
+        for (unsigned int c = size + 1; c-- > 0; ) {
+            at_least += counts[c];
+            if (counts[c] != 0) {
+                lower_bound = c;
+            }
+            if (RBT_snapshot_lower_bound(snapshot, c) != lower_bound ||
+                    RBT_snapshot_count_at_least(snapshot, c) != at_least ||
+                    RBT_snapshot_has_at_least(snapshot, c) != (at_least != 0)) {
+                printf(ERROR "snapshot query for %u is wrong\n", c);
+                exit(1);
+            }
+        }
+        RBT_snapshot_free(snapshot);
+        RBT_free(tree);
+    }
+}
+
+// Check that each placement policy removes the expected node.
+void fit_tests() {
+    struct RBT nodes[6];
+    unsigned int capacities[6] = {40, 10, 30, 30, 20, 50};
+    RBT_fit_policy policies[] = {RBT_BEST_FIT, RBT_GOOD_FIT, RBT_FIRST_FIT,
+                                 RBT_NEXT_FIT, RBT_WORST_FIT};
+    for (int i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        RBT tree = NULL;
+        for (int j = 0; j < 6; j++) {
+            tree = RBT_add(tree, &nodes[j], capacities[j]);
+        }
+        RBT_fit fit = RBT_fit_new(policies[i]);
+        fit.slack = 100;
+
+        RBT removed;
+        tree = RBT_remove_fit(tree, &fit, 60, &removed);
+        if (removed != NULL) {
+            printf(ERROR "%s: no node should be at least 60\n",
+                    RBT_fit_name(fit.policy));
+            exit(1);
+        }
+
+        RBT expected = NULL;
+        switch (fit.policy) {
+            case RBT_BEST_FIT: expected = &nodes[4]; break;  // 20
+            case RBT_GOOD_FIT: expected = NULL; break;       // any >= 15
+            case RBT_FIRST_FIT: expected = &nodes[0]; break; // lowest address
+            case RBT_NEXT_FIT: expected = &nodes[4]; break;  // rover is 0
+            case RBT_WORST_FIT: expected = &nodes[5]; break; // 50
+        }
+        tree = RBT_remove_fit(tree, &fit, 15, &removed);
+        if (removed == NULL || removed->capacity < 15 ||
+                (expected != NULL && removed != expected)) {
+            printf(ERROR "%s: removed the wrong node\n", RBT_fit_name(fit.policy));
+            exit(1);
+        }
+        if (fit.policy == RBT_NEXT_FIT) {
+            // the rover is now 20, so the next request continues from there
+            tree = RBT_remove_fit(tree, &fit, 15, &removed);
+            if (removed == NULL || removed->capacity != 30) {
+                printf(ERROR "next fit: rover was not advanced\n");
+                exit(1);
+            }
+        }
+    }
+
+    // good fit prefers capacities with duplicates
+    RBT tree = NULL;
+    for (int j = 0; j < 6; j++) {
+        tree = RBT_add(tree, &nodes[j], capacities[j]);
+    }
+    RBT_fit fit = RBT_fit_new(RBT_GOOD_FIT);
+    fit.slack = 100;
+    fit.duplicates = true;
+    RBT removed;
+    tree = RBT_remove_fit(tree, &fit, 15, &removed);
+    if (removed == NULL || removed->capacity != 30) {
+        printf(ERROR "good fit should prefer a capacity with duplicates\n");
+        exit(1);
+    }
+    tree = RBT_remove_fit(tree, &fit, 15, &removed); // no duplicates remain
+    if (removed == NULL || removed->capacity < 15) {
+        printf(ERROR "good fit should fall back without duplicates\n");
+        exit(1);
+    }
+}
+
+// Check that an MRU-cached tree removes the same capacities as a plain tree
+// on bursts of requests for a few capacities, and that every cached node is
+// the head of its capacity's list in the tree.
+void mru_tests() {
+    RBT blocks = malloc(MRU_BLOCKS * sizeof(struct RBT));
+    bool in_tree[MRU_BLOCKS] = {false};
+    unsigned int counts[200] = {0};
+    RBT_mru mru;
+    RBT_mru_init(&mru);
+
+    if (RBT_mru_remove_at_least(&mru, 0) != NULL) {
+        printf(ERROR "empty MRU tree should remain empty\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < MRU_BLOCKS; i++) {
+        unsigned int next_val = rand() % 200;
+        RBT_mru_add(&mru, &blocks[i], next_val);
+        in_tree[i] = true;
+        counts[next_val]++;
+    }
+
+    unsigned int burst = 0;
+    for (unsigned int i = 0; i < 2 * MRU_BLOCKS; i++) {
+        if (i % 16 == 0) { // start a burst of requests for a new capacity
+            burst = rand() % 220;
+        }
+        RBT removed;
+        if (rand() % 4 == 0) { // remove a specific block
+            unsigned int j = rand() % MRU_BLOCKS;
+            removed = RBT_mru_remove_node(&mru, &blocks[j]);
+            if (removed != (in_tree[j] ? &blocks[j] : NULL)) {
+                printf(ERROR "RBT_mru_remove_node removed the wrong block\n");
+                exit(1);
+            }
+        } else {
+            unsigned int best = burst < 200 ? burst : 200;
+            while (best < 200 && counts[best] == 0) {
+                best++;
+            }
+            removed = RBT_mru_remove_at_least(&mru, burst);
+            if (best == 200 ? removed != NULL :
+                    (removed == NULL || removed->capacity != best)) {
+                printf(ERROR "RBT_mru_remove_at_least(%u) should remove %u\n",
+                        burst, best);
+                exit(1);
+            }
+        }
+        if (removed != NULL) {
+            in_tree[removed - blocks] = false;
+            counts[removed->capacity]--;
+            if (rand() % 2 == 0) { // free it again
+                RBT_mru_add(&mru, removed, removed->capacity);
+                in_tree[removed - blocks] = true;
+                counts[removed->capacity]++;
+            }
+        }
+
+        counts_ok(mru.root, counts);
+        for (int k = 0; k < RBT_MRU_SIZE; k++) {
+            RBT cached = mru.cache[k];
+            RBT_cursor cursor;
+            if (cached != NULL && cached !=
+                    RBT_cursor_seek_at_least(&cursor, mru.root, cached->capacity)) {
+                printf(ERROR "cached node %u is not in the tree\n", cached->capacity);
+                exit(1);
+            }
+        }
+    }
+    if (mru.hits == 0) {
+        printf(ERROR "bursts of requests should hit the MRU cache\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < MRU_BLOCKS; i++) {
+        if (in_tree[i] && RBT_mru_remove_node(&mru, &blocks[i]) != &blocks[i]) {
+            printf(ERROR "RBT_mru_remove_node should remove every block\n");
+            exit(1);
+        }
+    }
+    if (mru.root != NULL) {
+        printf(ERROR "MRU tree should be empty\n");
+        exit(1);
+    }
+    free(blocks);
+}
+
+// Check that a hash-indexed tree removes the same capacities as a plain tree,
+// and that its index holds exactly the tree nodes.
+void hash_tests() {
+    RBT blocks = malloc(HASH_BLOCKS * sizeof(struct RBT));
+    bool in_tree[HASH_BLOCKS] = {false};
+    unsigned int counts[500] = {0};
+    RBT_hash hash;
+    if (!RBT_hash_init(&hash)) {
+        printf(ERROR "RBT_hash_init failed\n");
+        exit(1);
+    }
+
+    if (RBT_hash_remove_at_least(&hash, 0) != NULL) {
+        printf(ERROR "empty hash-indexed tree should remain empty\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < HASH_BLOCKS; i++) {
+        unsigned int next_val = rand() % 500;
+        RBT_hash_add(&hash, &blocks[i], next_val);
+        in_tree[i] = true;
+        counts[next_val]++;
+    }
+
+    for (unsigned int i = 0; i < 2 * HASH_BLOCKS; i++) {
+        RBT removed;
+        if (rand() % 3 == 0) { // remove a specific block
+            unsigned int j = rand() % HASH_BLOCKS;
+            removed = RBT_hash_remove_node(&hash, &blocks[j]);
+            if (removed != (in_tree[j] ? &blocks[j] : NULL)) {
+                printf(ERROR "RBT_hash_remove_node removed the wrong block\n");
+                exit(1);
+            }
+        } else {
+            unsigned int requested = rand() % 550;
+            unsigned int best = requested < 500 ? requested : 500;
+            while (best < 500 && counts[best] == 0) {
+                best++;
+            }
+            removed = RBT_hash_remove_at_least(&hash, requested);
+            if (best == 500 ? removed != NULL :
+                    (removed == NULL || removed->capacity != best)) {
+                printf(ERROR "RBT_hash_remove_at_least(%u) should remove %u\n",
+                        requested, best);
+                exit(1);
+            }
+        }
+        if (removed != NULL) {
+            in_tree[removed - blocks] = false;
+            counts[removed->capacity]--;
+            if (rand() % 2 == 0) { // free it again, possibly with a new capacity
+                unsigned int next_val = rand() % 2 ? removed->capacity : rand() % 500;
+                RBT_hash_add(&hash, removed, next_val);
+                in_tree[removed - blocks] = true;
+                counts[next_val]++;
+            }
+        }
+
+        if (i % 100 == 0) { // the index should hold exactly the tree nodes
+            size_t size = 0;
+            RBT_cursor cursor;
+            for (RBT node = RBT_cursor_first(&cursor, hash.root); node != NULL;
+                    node = RBT_cursor_next(&cursor)) {
+                if (RBT_hash_find(&hash, node->capacity) != node) {
+                    printf(ERROR "tree node %u is not indexed\n", node->capacity);
+                    exit(1);
+                }
+                size++;
+            }
+            if (size != hash.size) {
+                printf(ERROR "index has %zu entries for %zu tree nodes\n",
+                        hash.size, size);
+                exit(1);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < HASH_BLOCKS; i++) {
+        if (in_tree[i] && RBT_hash_remove_node(&hash, &blocks[i]) != &blocks[i]) {
+            printf(ERROR "RBT_hash_remove_node should remove every block\n");
+            exit(1);
+        }
+    }
+    if (hash.root != NULL || hash.size != 0) {
+        printf(ERROR "hash-indexed tree should be empty\n");
+        exit(1);
+    }
+    RBT_hash_free(&hash);
+    free(blocks);
+}
+
+// Check that trees built in parallel (with various numbers of threads) are
+// valid RBTs containing every block, and that they can be modified.
+void parallel_tests() {
+    RBT blocks = malloc(PARALLEL_BLOCKS * sizeof(struct RBT));
+    RBT *nodes = malloc(PARALLEL_BLOCKS * sizeof(RBT));
+    unsigned int threads[] = {1, 3, 8, 0};
+    if (RBT_parallel_build(nodes, 0, 4) != NULL) {
+        printf(ERROR "a tree built from no nodes should be empty\n");
+        exit(1);
+    }
+    for (int t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        unsigned int counts[1000] = {0};
+        for (unsigned int i = 0; i < PARALLEL_BLOCKS; i++) {
+            blocks[i].capacity = rand() % 1000;
+            nodes[i] = &blocks[i];
+            counts[blocks[i].capacity]++;
+        }
+        RBT tree = RBT_parallel_build(nodes, PARALLEL_BLOCKS, threads[t]);
+        RBT_parallel_rep_ok(tree, threads[t]);
+
+        RBT_cursor cursor;
+        for (RBT node = RBT_cursor_first(&cursor, tree); node != NULL;
+                node = RBT_cursor_next_block(&cursor)) {
+            if (counts[node->capacity] == 0) {
+                printf(ERROR "%u threads: too many blocks of capacity %u\n",
+                        threads[t], node->capacity);
+                exit(1);
+            }
+            counts[node->capacity]--;
+        }
+        for (unsigned int c = 0; c < 1000; c++) {
+            if (counts[c] != 0) {
+                printf(ERROR "%u threads: missing blocks of capacity %u\n",
+                        threads[t], c);
+                exit(1);
+            }
+        }
+
+        for (unsigned int i = 0; i < 1000; i++) {
+            RBT removed;
+            tree = RBT_remove_at_least(tree, rand() % 1000, &removed);
+            if (removed != NULL) {
+                tree = RBT_add(tree, removed, rand() % 2000);
+            }
+        }
+        RBT_parallel_rep_ok(tree, threads[t]);
+        RBT_forget(tree);
+    }
+    free(nodes);
+    free(blocks);
+}
+
+// Worker process of shm_tests (run as `rbt_test --shm-worker name offset`):
+// attaches to the shared heap `name`, frees the buffer whose offset is the
+// first word of the mailbox at `offset` and posts the offset of a buffer of
+// its own in the second word. Returns the exit status.
+int shm_worker(const char *name, size_t offset) {
+    RBT_shm worker;
+    if (!RBT_shm_open(&worker, name)) {
+        return 1;
+    }
+    size_t *mailbox = RBT_shm_pointer(&worker, offset);
+    RBT_shm_free(&worker, RBT_shm_pointer(&worker, mailbox[0]));
+    char *worker_buffer = RBT_shm_alloc(&worker, 2000);
+    if (worker_buffer == NULL) {
+        return 2;
+    }
+    strcpy(worker_buffer, "written by the worker");
+    mailbox[1] = RBT_shm_offset(&worker, worker_buffer);
+    RBT_shm_close(&worker);
+    return 0;
+}
+
+// Check that a separately executed process (with a layout of its own) can
+// attach to a shared heap, free buffers the parent allocated and allocate
+// buffers the parent can read, and that the heap's lock survives the death of
+// a process holding it.
+void shm_tests() {
+    char name[64];
+    snprintf(name, sizeof(name), "/rbt_test_%d", (int)getpid());
+    RBT_shm parent, shm;
+    if (RBT_shm_create(&shm, name, SHM_SIZE, NULL, RBT_fit_new(RBT_BEST_FIT))) {
+        printf(ERROR "RBT_shm_create should require an address\n");
+        exit(1);
+    }
+    if (!RBT_shm_create(&parent, name, SHM_SIZE, RBT_SHM_BASE, RBT_fit_new(RBT_BEST_FIT))) {
+        printf(ERROR "RBT_shm_create failed\n");
+        exit(1);
+    }
+    if (RBT_shm_create(&shm, name, SHM_SIZE, RBT_SHM_BASE, RBT_fit_new(RBT_BEST_FIT))) {
+        printf(ERROR "RBT_shm_create should not replace an existing heap\n");
+        exit(1);
+    }
+    size_t *mailbox = RBT_shm_alloc(&parent, 4 * sizeof(size_t));
+    char *parent_buffer = RBT_shm_alloc(&parent, 1000);
+    mailbox[0] = RBT_shm_offset(&parent, parent_buffer);
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) { // a new program image, which attaches by name
+        char offset[32];
+        snprintf(offset, sizeof(offset), "%zu", RBT_shm_offset(&parent, mailbox));
+        execl("/proc/self/exe", "rbt_test", "--shm-worker", name, offset, (char *)NULL);
+        _exit(3);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf(ERROR "worker process could not use the shared heap\n");
+        exit(1);
+    }
+    char *worker_buffer = RBT_shm_pointer(&parent, mailbox[1]);
+    if (strcmp(worker_buffer, "written by the worker") != 0) {
+        printf(ERROR "parent should see the worker's buffer\n");
+        exit(1);
+    }
+
+    pid = fork();
+    if (pid == 0) { // die while holding the lock
+        RBT_shm_lock(&parent);
+        _exit(0);
+    }
+    waitpid(pid, &status, 0);
+    if (!RBT_shm_lock(&parent) || parent.region->owner_deaths != 1) {
+        printf(ERROR "the lock should be recovered from a dead process\n");
+        exit(1);
+    }
+    RBT_heap_ok(&parent.region->heap);
+    RBT_shm_unlock(&parent);
+
+    RBT_shm_free(&parent, worker_buffer);
+    RBT_shm_free(&parent, mailbox);
+    RBT_heap_flush(&parent.region->heap);
+    RBT_heap_stats stats;
+    RBT_heap_get_stats(&parent.region->heap, &stats);
+    if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+        printf(ERROR "freed shared heap should be a single block\n");
+        exit(1);
+    }
+    RBT_shm_close(&parent);
+    if (!RBT_shm_unlink(name) || RBT_shm_open(&shm, name)) {
+        printf(ERROR "unlinked shared heap should not be openable\n");
+        exit(1);
+    }
+}
+
+// Check that NUMA arenas serve allocations (locally, when the node of the
+// calling thread has an arena) and take back freed memory.
+void numa_tests() {
+    RBT_numa numa;
+    if (!RBT_numa_init(&numa, NUMA_SIZE, RBT_fit_new(RBT_BEST_FIT)) ||
+            numa.num_arenas < 1) {
+        printf(ERROR "RBT_numa_init should create at least one arena\n");
+        exit(1);
+    }
+    // the arena of the calling thread's node serves it (whether or not its
+    // memory could be bound)
+    int node = RBT_numa_current_node();
+    for (int i = 0; i < numa.num_arenas; i++) {
+        if (numa.arenas[i].node != node) {
+            continue;
+        }
+        void *local = RBT_numa_alloc(&numa, 100);
+        if (RBT_numa_arena_of(&numa, local) != &numa.arenas[i] ||
+                numa.arenas[i].local_allocs != 1) {
+            printf(ERROR "node %d should allocate from its own arena\n", node);
+            exit(1);
+        }
+        RBT_numa_free(&numa, local);
+        numa.arenas[i].local_allocs = 0;
+    }
+    void *ptrs[HEAP_PTRS];
+    for (int k = 0; k < HEAP_PTRS; k++) {
+        ptrs[k] = RBT_numa_alloc(&numa, 1 + rand() % 1000);
+        RBT_numa_arena *arena = RBT_numa_arena_of(&numa, ptrs[k]);
+        if (arena == NULL) {
+            printf(ERROR "NUMA allocation %d is not in an arena\n", k);
+            exit(1);
+        }
+        if (numa.num_arenas == 1 && arena->local_allocs != k + 1) {
+            printf(ERROR "allocations from a single arena should be local\n");
+            exit(1);
+        }
+    }
+    if (RBT_numa_alloc(&numa, NUMA_SIZE) != NULL) {
+        printf(ERROR "no arena should fit %d bytes\n", NUMA_SIZE);
+        exit(1);
+    }
+    for (int k = 0; k < HEAP_PTRS; k++) {
+        RBT_numa_free(&numa, ptrs[k]);
+    }
+    for (int i = 0; i < numa.num_arenas; i++) {
+        RBT_heap *heap = &numa.arenas[i].heap;
+        RBT_heap_flush(heap);
+        RBT_heap_ok(heap);
+        if (heap->used_bytes != 0) {
+            printf(ERROR "NUMA arena %d should be empty\n", i);
+            exit(1);
+        }
+    }
+    RBT_numa_destroy(&numa);
+}
+
+// Check aligned heap allocations, and that slab objects do not overlap and
+// that empty slabs are returned to the heap.
+void slab_tests() {
+    void *mem = malloc(SLAB_HEAP_SIZE);
+    RBT_heap heap;
+    RBT_heap_init(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    void *aligned[64];
+    for (int k = 0; k < 64; k++) {
+        size_t align = (size_t)16 << (k % 12);
+        aligned[k] = RBT_heap_alloc_aligned(&heap, 1 + rand() % 3000, align);
+        if (aligned[k] == NULL || (size_t)aligned[k] % align != 0) {
+            printf(ERROR "RBT_heap_alloc_aligned(..., %zu) failed\n", align);
+            exit(1);
+        }
+        RBT_heap_ok(&heap);
+    }
+    for (int k = 0; k < 64; k++) {
+        RBT_heap_free(&heap, aligned[k]);
+    }
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+
+    RBT_slab_cache cache;
+    if (RBT_slab_cache_init(&cache, &heap, 0) ||
+            RBT_slab_cache_init(&cache, &heap, RBT_SLAB_MAX_OBJECT + 1) ||
+            !RBT_slab_cache_init(&cache, &heap, 40)) {
+        printf(ERROR "RBT_slab_cache_init accepted a bad size\n");
+        exit(1);
+    }
+    unsigned char **objects = malloc(SLAB_OBJECTS * sizeof(unsigned char *));
+    for (int k = 0; k < SLAB_OBJECTS; k++) {
+        objects[k] = RBT_slab_alloc(&cache);
+        if (objects[k] == NULL || (size_t)objects[k] % RBT_HEAP_ALIGN != 0) {
+            printf(ERROR "bad slab allocation\n");
+            exit(1);
+        }
+        memset(objects[k], k, cache.object_size);
+    }
+    size_t slabs = (SLAB_OBJECTS + cache.slots - 1) / cache.slots;
+    if (cache.num_slabs != slabs) {
+        printf(ERROR "%d objects should fill %zu slabs (not %zu)\n",
+                SLAB_OBJECTS, slabs, cache.num_slabs);
+        exit(1);
+    }
+    for (int j = 0; j < 4 * SLAB_OBJECTS; j++) { // churn
+        int k = rand() % SLAB_OBJECTS;
+        for (size_t b = 0; b < cache.object_size; b++) {
+            if (objects[k][b] != (unsigned char)k) {
+                printf(ERROR "slab object %d was overwritten\n", k);
+                exit(1);
+            }
+        }
+        RBT_slab_free(&cache, objects[k]);
+        objects[k] = RBT_slab_alloc(&cache);
+        memset(objects[k], k, cache.object_size);
+    }
+    for (int k = 0; k < SLAB_OBJECTS; k++) {
+        RBT_slab_free(&cache, objects[k]);
+    }
+    if (cache.num_slabs != 1) {
+        printf(ERROR "empty slabs should be returned to the heap\n");
+        exit(1);
+    }
+    RBT_slab_cache_destroy(&cache);
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+    RBT_heap_stats stats;
+    RBT_heap_get_stats(&heap, &stats);
+    if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+        printf(ERROR "heap should be a single free block after the slabs\n");
+        exit(1);
+    }
+    free(objects);
+
+    // slabs fill the heap (with either header, and with size classes), less
+    // the window cut by the start of the region and the over-allocation of
+    // the last slab
+    void **filled = malloc(SLAB_HEAP_SIZE / RBT_SLAB_MAX_OBJECT * sizeof(void *));
+    for (int variant = 0; variant < 3; variant++) {
+        if (variant == 1) {
+            RBT_heap_init_split(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        } else {
+            RBT_heap_init(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+            heap.class_bits = variant == 2 ? 3 : 0;
+        }
+        RBT_slab_cache_init(&cache, &heap, RBT_SLAB_MAX_OBJECT);
+        size_t count = 0;
+        while ((filled[count] = RBT_slab_alloc(&cache)) != NULL) {
+            memset(filled[count], 0xab, cache.object_size);
+            count++;
+        }
+        RBT_heap_ok(&heap);
+        if (cache.num_slabs < SLAB_HEAP_SIZE / RBT_SLAB_SIZE - 3) {
+            printf(ERROR "a heap of %d bytes should fit more than %zu slabs\n",
+                    SLAB_HEAP_SIZE, cache.num_slabs);
+            exit(1);
+        }
+        for (size_t k = 0; k < count; k++) {
+            RBT_slab_free(&cache, filled[k]);
+        }
+        RBT_slab_cache_destroy(&cache);
+        RBT_heap_flush(&heap);
+        RBT_heap_ok(&heap);
+    }
+    free(filled);
+    free(mem);
+}
+
+// Check that region objects do not overlap, that large objects get chunks of
+// their own, and that a reset returns every chunk to the heap.
+void region_tests() {
+    void *mem = malloc(SLAB_HEAP_SIZE);
+    RBT_heap heap;
+    RBT_heap_init(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    RBT_heap_stats stats;
+    RBT_region region;
+    RBT_region_init(&region, &heap, 4096);
+    unsigned char **objects = malloc(REGION_OBJECTS * sizeof(unsigned char *));
+    size_t *sizes = malloc(REGION_OBJECTS * sizeof(size_t));
+    for (int round = 0; round < 3; round++) {
+        for (int k = 0; k < REGION_OBJECTS; k++) {
+            sizes[k] = rand() % 100 == 0 ? 1024 + rand() % 4096 : rand() % 128;
+            objects[k] = RBT_region_alloc(&region, sizes[k]);
+            if (objects[k] == NULL || (size_t)objects[k] % RBT_HEAP_ALIGN != 0) {
+                printf(ERROR "bad region allocation\n");
+                exit(1);
+            }
+            memset(objects[k], k, sizes[k]);
+        }
+        for (int k = 0; k < REGION_OBJECTS; k++) {
+            for (size_t b = 0; b < sizes[k]; b++) {
+                if (objects[k][b] != (unsigned char)k) {
+                    printf(ERROR "region object %d was overwritten\n", k);
+                    exit(1);
+                }
+            }
+        }
+        if (region.num_chunks < 2) {
+            printf(ERROR "region should have chained chunks\n");
+            exit(1);
+        }
+        RBT_heap_ok(&heap);
+        RBT_region_reset(&region);
+        if (region.num_chunks != 0 || region.bytes != 0 || heap.used_bytes != 0) {
+            printf(ERROR "reset region should hold no chunks\n");
+            exit(1);
+        }
+        RBT_heap_flush(&heap);
+        RBT_heap_ok(&heap);
+        RBT_heap_get_stats(&heap, &stats);
+        if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+            printf(ERROR "heap should be a single free block after a reset\n");
+            exit(1);
+        }
+    }
+    if (RBT_region_alloc(&region, SLAB_HEAP_SIZE) != NULL) {
+        printf(ERROR "region should not fit %d bytes\n", SLAB_HEAP_SIZE);
+        exit(1);
+    }
+
+    RBT_region small; // many adjacent chunks, between two blocks in use
+    RBT_region_init(&small, &heap, 256);
+    for (int k = 0; k < REGION_CHUNKS; k++) {
+        if (RBT_region_alloc(&small, 200) == NULL) {
+            printf(ERROR "bad region allocation\n");
+            exit(1);
+        }
+    }
+    void *guard = RBT_heap_alloc(&heap, 100);
+    if (small.num_chunks != REGION_CHUNKS) {
+        printf(ERROR "region should have %d chunks\n", REGION_CHUNKS);
+        exit(1);
+    }
+    RBT_region_reset(&small);
+    RBT_heap_ok(&heap);
+    RBT_heap_get_stats(&heap, &stats);
+    if (stats.used_blocks != 1 || stats.free_blocks != 2) {
+        printf(ERROR "adjacent chunks should come back as one free block\n");
+        exit(1);
+    }
+    RBT_heap_free(&heap, guard);
+    RBT_heap_flush(&heap);
+
+    void *ptrs[HEAP_PTRS];
+    for (int k = 0; k < HEAP_PTRS; k++) { // batched frees of scattered blocks
+        ptrs[k] = RBT_heap_alloc(&heap, 1 + rand() % 1000);
+    }
+    void *kept[HEAP_PTRS / 2];
+    for (int k = 0; k < HEAP_PTRS; k += 2) {
+        kept[k / 2] = ptrs[k];
+        ptrs[k] = NULL;
+    }
+    RBT_heap_free_batch(&heap, ptrs, HEAP_PTRS);
+    RBT_heap_ok(&heap);
+    RBT_heap_free_batch(&heap, kept, HEAP_PTRS / 2);
+    RBT_heap_ok(&heap);
+    RBT_heap_get_stats(&heap, &stats);
+    if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+        printf(ERROR "heap should be a single free block after batched frees\n");
+        exit(1);
+    }
+
+    for (int k = 0; k < HEAP_PTRS; k++) { // the same, with lists
+        ptrs[k] = RBT_heap_alloc(&heap, sizeof(void *) + rand() % 1000);
+    }
+    for (int round = 0; round < 2; round++) {
+        void *head = NULL;
+        for (int k = round; k < HEAP_PTRS; k += 2) {
+            int i = k + 2 * (rand() % ((HEAP_PTRS - k + 1) / 2)); // (in random order)
+            void *ptr = ptrs[i];
+            ptrs[i] = ptrs[k];
+            ptrs[k] = ptr;
+            *(void **)ptr = head;
+            head = ptr;
+        }
+        RBT_heap_free_list(&heap, head);
+        RBT_heap_ok(&heap);
+    }
+    RBT_heap_get_stats(&heap, &stats);
+    if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+        printf(ERROR "heap should be a single free block after freed lists\n");
+        exit(1);
+    }
+    free(sizes);
+    free(objects);
+    free(mem);
+}
+
+// Check that compaction moves relocatable objects (keeping their contents),
+// leaves pinned blocks in place and leaves one free block after each of them.
+void handle_tests() {
+    void *mem = malloc(SLAB_HEAP_SIZE);
+    RBT_heap heap;
+    RBT_heap_init(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    RBT_handle_table table;
+    if (!RBT_handle_table_init(&table, &heap)) {
+        printf(ERROR "RBT_handle_table_init failed\n");
+        exit(1);
+    }
+    RBT_handle *handles = malloc(HANDLE_OBJECTS * sizeof(RBT_handle));
+    size_t *sizes = malloc(HANDLE_OBJECTS * sizeof(size_t));
+    void *pinned[8];
+    for (int k = 0; k < HANDLE_OBJECTS; k++) {
+        if (k % (HANDLE_OBJECTS / 8) == 0) {
+            int i = k / (HANDLE_OBJECTS / 8);
+            pinned[i] = RBT_heap_alloc(&heap, 100);
+            memset(pinned[i], 0xa0 + i, 100);
+        }
+        sizes[k] = 1 + rand() % 500;
+        handles[k] = RBT_handle_alloc(&table, sizes[k]);
+        if (handles[k] == 0) {
+            printf(ERROR "RBT_handle_alloc failed\n");
+            exit(1);
+        }
+        memset(RBT_handle_get(&table, handles[k]), k, sizes[k]);
+    }
+    for (int k = 0; k < HANDLE_OBJECTS; k += 2) { // fragment the heap
+        RBT_handle_free(&table, handles[k]);
+        handles[k] = 0;
+    }
+    RBT_heap_stats before;
+    RBT_heap_flush(&heap);
+    RBT_heap_get_stats(&heap, &before);
+
+    if (!RBT_handle_compact(&table)) {
+        printf(ERROR "RBT_handle_compact failed\n");
+        exit(1);
+    }
+    RBT_heap_ok(&heap);
+    RBT_heap_stats after;
+    RBT_heap_get_stats(&heap, &after);
+    if (after.free_blocks > 8 || after.free_bytes <= before.free_bytes ||
+            after.largest_free <= before.largest_free || after.used_blocks != before.used_blocks) {
+        printf(ERROR "compaction should leave at most one free block per pinned block "
+               "(not %zu)\n", after.free_blocks);
+        exit(1);
+    }
+    for (int i = 0; i < 8; i++) { // pinned blocks stay where they are
+        RBT block = (RBT)((char *)pinned[i] - heap.header_size);
+        unsigned char *object = pinned[i];
+        if (!block->in_use || RBT_heap_usable_size(&heap, pinned[i]) < 100) {
+            printf(ERROR "pinned block %d was moved or freed\n", i);
+            exit(1);
+        }
+        for (size_t b = 0; b < 100; b++) {
+            if (object[b] != (unsigned char)(0xa0 + i)) {
+                printf(ERROR "pinned block %d was overwritten\n", i);
+                exit(1);
+            }
+        }
+    }
+    for (int k = 1; k < HANDLE_OBJECTS; k += 2) {
+        unsigned char *object = RBT_handle_get(&table, handles[k]);
+        for (size_t b = 0; b < sizes[k]; b++) {
+            if (object[b] != (unsigned char)k) {
+                printf(ERROR "relocated object %d was overwritten\n", k);
+                exit(1);
+            }
+        }
+    }
+    if (RBT_heap_alloc(&heap, after.largest_free) == NULL) {
+        printf(ERROR "largest free block should be allocatable\n");
+        exit(1);
+    }
+
+    for (int k = 1; k < HANDLE_OBJECTS; k += 2) { // handles are reused
+        RBT_handle_free(&table, handles[k]);
+    }
+    if (table.count != 0 ||
+            RBT_handle_alloc(&table, 10) != handles[HANDLE_OBJECTS - 1]) {
+        printf(ERROR "freed handles should be reused\n");
+        exit(1);
+    }
+
+    // a slot inside or past the last block raises SIGABRT
+    void *bad[] = {heap.end - RBT_HEAP_ALIGN, heap.end + 4 * RBT_HEAP_ALIGN};
+    for (int i = 0; i < 2; i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            freopen("/dev/null", "w", stdout);
+            void *slots[] = {pinned[0], bad[i]};
+            RBT_heap_compact(&heap, slots, 2);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) {
+            printf(ERROR "compacting slot %p should raise SIGABRT\n", bad[i]);
+            exit(1);
+        }
+    }
+    RBT_handle_table_destroy(&table);
+    free(sizes);
+    free(handles);
+    free(mem);
+}
+
+// helper: allocation sites with distinct call stacks for profile_tests.
+__attribute__((noinline)) void *profile_site_a(RBT_heap *heap, size_t size) {
+    return RBT_heap_alloc(heap, size);
+}
+
+__attribute__((noinline)) void *profile_site_b(RBT_heap *heap, size_t size) {
+    return RBT_heap_alloc_aligned(heap, size, 64);
+}
+
+// Check that a profile samples every allocation at rate 1 and drops the
+// samples of freed (and follows those of moved) blocks, that its table fills
+// up, that the default rate takes about one sample per RBT_PROFILE_RATE bytes,
+// and that the pprof output has one line per stack.
+void profile_tests() {
+    void *mem = malloc(SLAB_HEAP_SIZE);
+    RBT_heap heap;
+    RBT_heap_init(&heap, mem, SLAB_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    RBT_profile *profile = malloc(sizeof(RBT_profile));
+    RBT_profile_init(profile, 1);
+    heap.profile = profile;
+    void *objects[PROFILE_OBJECTS];
+    for (int k = 0; k < PROFILE_OBJECTS; k++) {
+        objects[k] = k % 2 == 0 ? profile_site_a(&heap, 100) : profile_site_b(&heap, 300);
+    }
+    for (int k = 0; k < PROFILE_OBJECTS; k += 4) { // fragment the heap
+        RBT_heap_free(&heap, objects[k]);
+        objects[k] = NULL;
+    }
+    size_t live = PROFILE_OBJECTS - PROFILE_OBJECTS / 4;
+    if (profile->num_samples != live || profile->sampled != PROFILE_OBJECTS) {
+        printf(ERROR "profile has %zu samples (of %zu) instead of %zu\n",
+                profile->num_samples, profile->sampled, live);
+        exit(1);
+    }
+
+    // the pprof output has a line for each of the two stacks
+    size_t bytes = 0;
+    for (int k = 0; k < PROFILE_OBJECTS; k++) {
+        if (objects[k] != NULL) {
+            bytes += k % 2 == 0 ? 100 : 300;
+        }
+    }
+    FILE *out = tmpfile();
+    if (out == NULL || !RBT_profile_write(profile, out)) {
+        printf(ERROR "RBT_profile_write failed\n");
+        exit(1);
+    }
+    rewind(out);
+    char line[4096];
+    size_t count, total, rate;
+    if (fgets(line, sizeof(line), out) == NULL ||
+            sscanf(line, "heap profile: %zu: %zu [%*u: %*u] @ heap_v2/%zu",
+                &count, &total, &rate) != 3 ||
+            count != live || total != bytes || rate != 1) {
+        printf(ERROR "bad pprof header: %s", line);
+        exit(1);
+    }
+    size_t stacks = 0;
+    count = 0;
+    bool mapped = false;
+    while (fgets(line, sizeof(line), out) != NULL) {
+        size_t n;
+        if (sscanf(line, "%zu: %*u [%*u: %*u] @ 0x", &n) == 1 && strstr(line, "@ 0x")) {
+            stacks++;
+            count += n;
+        } else if (strcmp(line, "MAPPED_LIBRARIES:\n") == 0) {
+            mapped = true;
+        }
+    }
+    fclose(out);
+    if (stacks != 2 || count != live || !mapped) {
+        printf(ERROR "pprof output has %zu stacks with %zu samples%s\n", stacks,
+                count, mapped ? "" : " and no memory map");
+        exit(1);
+    }
+
+    // samples follow the blocks that are moved, and are dropped when freed
+    RBT_heap_compact(&heap, objects, PROFILE_OBJECTS);
+    if (profile->num_samples != live) {
+        printf(ERROR "compaction lost samples\n");
+        exit(1);
+    }
+    RBT_heap_free_batch(&heap, objects, PROFILE_OBJECTS / 2);
+    for (int k = PROFILE_OBJECTS / 2; k < PROFILE_OBJECTS; k++) {
+        RBT_heap_free(&heap, objects[k]);
+    }
+    if (profile->num_samples != 0) {
+        printf(ERROR "samples of freed blocks were not dropped (%zu left)\n",
+                profile->num_samples);
+        exit(1);
+    }
+
+    // samples are dropped once the table is 3/4 full
+    void **small = malloc(RBT_PROFILE_SAMPLES * sizeof(void *));
+    for (int k = 0; k < RBT_PROFILE_SAMPLES; k++) {
+        small[k] = RBT_heap_alloc(&heap, 16);
+    }
+    if (profile->num_samples != RBT_PROFILE_SAMPLES / 4 * 3 ||
+            profile->dropped != RBT_PROFILE_SAMPLES - RBT_PROFILE_SAMPLES / 4 * 3) {
+        printf(ERROR "a full table has %zu samples and dropped %zu\n",
+                profile->num_samples, profile->dropped);
+        exit(1);
+    }
+    RBT_heap_free_batch(&heap, small, RBT_PROFILE_SAMPLES);
+    free(small);
+
+    // at the default rate, about one sample is taken per RBT_PROFILE_RATE bytes
+    RBT_profile_init(profile, RBT_PROFILE_RATE);
+    for (int j = 0; j < PROFILE_CHURN; j++) {
+        RBT_heap_free(&heap, RBT_heap_alloc(&heap, 1024));
+    }
+    size_t expected = (size_t)PROFILE_CHURN * 1024 / RBT_PROFILE_RATE;
+    if (profile->sampled < expected * 3 / 4 || profile->sampled > expected * 5 / 4 ||
+            profile->num_samples != 0) {
+        printf(ERROR "%d allocations of 1 KiB took %zu samples (not about %zu)\n",
+                PROFILE_CHURN, profile->sampled, expected);
+        exit(1);
+    }
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+    free(profile);
+    free(mem);
+}
+
+// Check that allocations from a heap do not overlap, that blocks are split
+// and coalesced, and that freeing everything restores a single free block
+// (for every placement policy).
+void heap_tests() {
+    RBT_fit_policy policies[] = {RBT_BEST_FIT, RBT_GOOD_FIT, RBT_FIRST_FIT,
+                                 RBT_NEXT_FIT, RBT_WORST_FIT};
+    void *mem = malloc(HEAP_SIZE);
+    for (int n = 0; n < 2 * sizeof(policies) / sizeof(policies[0]); n++) {
+        int i = n / 2;
+        bool split = n % 2 == 1; // with split headers
+        RBT_heap heap;
+        RBT_fit fit = RBT_fit_new(policies[i]);
+        fit.percent = 10;
+        if (!(split ? RBT_heap_init_split : RBT_heap_init)(&heap, mem, HEAP_SIZE, fit)) {
+            printf(ERROR "heap should have been initialized\n");
+            exit(1);
+        }
+        size_t total = heap.free_bytes;
+        // vary the size of the staging bin (disabling it for BEST_FIT and NEXT_FIT)
+        heap.bin_limit = i % 2 == 0 ? RBT_HEAP_BIN_SIZE : i / 2;
+        heap.class_bits = i % 3;
+
+        unsigned char *ptrs[HEAP_PTRS] = {NULL};
+        size_t sizes[HEAP_PTRS] = {0};
+        for (int j = 0; j < 20000; j++) {
+            int k = rand() % HEAP_PTRS;
+            if (ptrs[k] != NULL) {
+                for (size_t b = 0; b < sizes[k]; b++) {
+                    if (ptrs[k][b] != (unsigned char)k) {
+                        printf(ERROR "%s: allocation %d was overwritten\n",
+                                RBT_fit_name(fit.policy), k);
+                        exit(1);
+                    }
+                }
+                RBT_heap_free(&heap, ptrs[k]);
+                ptrs[k] = NULL;
+            } else {
+                sizes[k] = rand() % 4096;
+                ptrs[k] = RBT_heap_alloc(&heap, sizes[k]);
+                if (ptrs[k] == NULL) {
+                    continue;
+                }
+                if ((size_t)ptrs[k] % RBT_HEAP_ALIGN != 0 ||
+                        RBT_heap_usable_size(&heap, ptrs[k]) < sizes[k]) {
+                    printf(ERROR "%s: bad allocation\n", RBT_fit_name(fit.policy));
+                    exit(1);
+                }
+                memset(ptrs[k], k, sizes[k]);
+            }
+            if (j % 1000 == 0) {
+                RBT_heap_ok(&heap);
+            }
+        }
+        for (int k = 0; k < HEAP_PTRS; k++) {
+            RBT_heap_free(&heap, ptrs[k]);
+        }
+        RBT_heap_ok(&heap);
+        RBT_heap_flush(&heap);
+        RBT_heap_ok(&heap);
+
+        RBT_heap_stats stats;
+        RBT_heap_get_stats(&heap, &stats);
+        if (stats.free_blocks != 1 || stats.used_blocks != 0 ||
+                stats.free_bytes != total) {
+            printf(ERROR "%s: freed heap should be a single block\n",
+                    RBT_fit_name(fit.policy));
+            exit(1);
+        }
+        heap.class_bits = 0;
+        if (RBT_heap_alloc(&heap, total + 1) != NULL ||
+                RBT_heap_alloc(&heap, total) == NULL) {
+            printf(ERROR "%s: heap should fit exactly %zu bytes\n",
+                    RBT_fit_name(fit.policy), total);
+            exit(1);
+        }
+    }
+
+    // freed blocks are staged and reused before they reach the index
+    RBT_heap heap;
+    RBT_heap_init(&heap, mem, HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    void *a = RBT_heap_alloc(&heap, 100);
+    void *b = RBT_heap_alloc(&heap, 200);
+    void *c = RBT_heap_alloc(&heap, 300);
+    RBT_heap_free(&heap, b);
+    if (RBT_heap_alloc(&heap, 200) != b || heap.bin_hits != 1) {
+        printf(ERROR "a staged block should be reused for the same size\n");
+        exit(1);
+    }
+    RBT_heap_free(&heap, a);
+    RBT_heap_free(&heap, b);
+    RBT_heap_free(&heap, c);
+    RBT_heap_ok(&heap);
+    if (heap.bin_count != 3 || RBT_heap_alloc(&heap, 50) != a ||
+            heap.bin_count != 0) {
+        printf(ERROR "a miss should flush (and coalesce) the staging bin\n");
+        exit(1);
+    }
+    RBT_heap_ok(&heap);
+
+    // a limit above the size of the bin stages at most RBT_HEAP_BIN_SIZE blocks
+    RBT_heap_init(&heap, mem, HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    heap.bin_limit = 4 * RBT_HEAP_BIN_SIZE;
+    void *staged[3 * RBT_HEAP_BIN_SIZE];
+    for (int k = 0; k < 3 * RBT_HEAP_BIN_SIZE; k++) {
+        staged[k] = RBT_heap_alloc(&heap, 64);
+    }
+    for (int k = 0; k < 3 * RBT_HEAP_BIN_SIZE; k++) {
+        RBT_heap_free(&heap, staged[k]);
+        if (heap.bin_count > RBT_HEAP_BIN_SIZE ||
+                heap.bin_limit != 4 * RBT_HEAP_BIN_SIZE) {
+            printf(ERROR "the staging bin overflowed its %d blocks\n", RBT_HEAP_BIN_SIZE);
+            exit(1);
+        }
+    }
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+
+    // split headers cost 8 bytes per block (instead of 32)
+    RBT_heap_init_split(&heap, mem, HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    char *x = RBT_heap_alloc(&heap, 20);
+    char *y = RBT_heap_alloc(&heap, 24);
+    char *z = RBT_heap_alloc(&heap, 25);
+    if (y - x != 32 || z - y != 32 || RBT_heap_usable_size(&heap, x) != 24 ||
+            RBT_heap_usable_size(&heap, z) != 40 || (size_t)x % RBT_HEAP_ALIGN != 0) {
+        printf(ERROR "split headers should take 8 bytes\n");
+        exit(1);
+    }
+    RBT_heap_free(&heap, y);
+    RBT_heap_free(&heap, x);
+    RBT_heap_free(&heap, z);
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+
+    // size classes are at most 12.5% apart with class_bits = 3
+    RBT_heap_init(&heap, mem, HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    heap.class_bits = 3;
+    unsigned int prev_class = 0;
+    size_t num_classes = 0;
+    for (size_t size = 1; size <= 1 << 20; size++) {
+        unsigned int class = RBT_heap_class(&heap, size);
+        if (class < size || class % RBT_HEAP_ALIGN != 0 ||
+                (size > RBT_HEAP_CLASS_LINEAR && class - size >= size / 8) ||
+                (size <= RBT_HEAP_CLASS_LINEAR && class - size >= RBT_HEAP_ALIGN)) {
+            printf(ERROR "%zu bytes should not be rounded to %u\n", size, class);
+            exit(1);
+        }
+        num_classes += class != prev_class;
+        prev_class = class;
+    }
+    if (num_classes != RBT_HEAP_CLASS_LINEAR / RBT_HEAP_ALIGN + 8 * 11) {
+        printf(ERROR "there should not be %zu size classes up to 1 MiB\n", num_classes);
+        exit(1);
+    }
+
+    // aligned payloads get a whole size class after the leading block is cut
+    RBT_heap_init(&heap, mem, HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+    void *lead = RBT_heap_alloc(&heap, 4016);
+    heap.class_bits = 3;
+    void *aligned[64];
+    aligned[0] = RBT_heap_alloc_aligned(&heap, 2000, 4096);
+    for (int k = 1; k < 64; k++) {
+        aligned[k] = RBT_heap_alloc_aligned(&heap, 1 + rand() % 5000, (size_t)32 << (k % 8));
+    }
+    for (int k = 0; k < 64; k++) {
+        size_t align = k == 0 ? 4096 : (size_t)32 << (k % 8);
+        if (aligned[k] == NULL || (size_t)aligned[k] % align != 0) {
+            printf(ERROR "RBT_heap_alloc_aligned(..., %zu) failed with size classes\n",
+                    align);
+            exit(1);
+        }
+        RBT_heap_ok(&heap);
+    }
+    if (RBT_heap_usable_size(&heap, aligned[0]) < RBT_heap_class(&heap, 2000)) {
+        printf(ERROR "an aligned block is smaller than its size class\n");
+        exit(1);
+    }
+    RBT_heap_free_batch(&heap, aligned, 64);
+    RBT_heap_free(&heap, lead);
+    RBT_heap_flush(&heap);
+    RBT_heap_ok(&heap);
+    free(mem);
+
+    // blocks of the largest capacity (with either header) are linked to their
+    // neighbours in a heap over 1 GiB (whose pages are never touched but for
+    // the headers)
+    void *huge = mmap(NULL, HUGE_HEAP_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (huge == MAP_FAILED) {
+        printf(ERROR "cannot map %zu bytes\n", HUGE_HEAP_SIZE);
+        exit(1);
+    }
+    for (int split = 0; split < 2; split++) {
+        if (split) {
+            RBT_heap_init_split(&heap, huge, HUGE_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        } else {
+            RBT_heap_init(&heap, huge, HUGE_HEAP_SIZE, RBT_fit_new(RBT_BEST_FIT));
+        }
+        RBT_heap_ok(&heap);
+        void *largest = RBT_heap_alloc(&heap, heap.max_capacity);
+        void *rest = RBT_heap_alloc(&heap, HUGE_HEAP_SIZE / 4);
+        if (largest == NULL || rest == NULL ||
+                RBT_heap_usable_size(&heap, largest) != heap.max_capacity) {
+            printf(ERROR "a heap over 1 GiB should fit a block of %zu bytes\n",
+                    heap.max_capacity);
+            exit(1);
+        }
+        RBT_heap_ok(&heap);
+        RBT_heap_free(&heap, largest);
+        RBT_heap_free(&heap, rest);
+        RBT_heap_flush(&heap);
+        RBT_heap_ok(&heap);
+    }
+    munmap(huge, HUGE_HEAP_SIZE);
+}
+
 // Test operations on RBTs.
-int main(void) {
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "--shm-worker") == 0) {
+        return shm_worker(argv[2], strtoull(argv[3], NULL, 10));
+    }
     printf("struct RBT: %lu bytes (%lu double-words)\n", sizeof(struct RBT),
             sizeof(struct RBT) / DOUBLE_WORD_SIZE);
 
@@ -625,6 +2226,40 @@ int main(void) {
     printf("PASSED: rbt_insertion_test_1\n");
     rbt_insertion_test_2();
     printf("PASSED: rbt_insertion_test_2\n");
+    good_fit_tests();
+    printf("PASSED: good_fit_tests\n");
+    cursor_tests();
+    printf("PASSED: cursor_tests\n");
+    destroy_tests();
+    printf("PASSED: destroy_tests\n");
+    bpt_tests();
+    printf("PASSED: bpt_tests\n");
+    wavl_tests();
+    printf("PASSED: wavl_tests\n");
+    snapshot_tests();
+    printf("PASSED: snapshot_tests\n");
+    fit_tests();
+    printf("PASSED: fit_tests\n");
+    heap_tests();
+    printf("PASSED: heap_tests\n");
+    mru_tests();
+    printf("PASSED: mru_tests\n");
+    hash_tests();
+    printf("PASSED: hash_tests\n");
+    parallel_tests();
+    printf("PASSED: parallel_tests\n");
+    shm_tests();
+    printf("PASSED: shm_tests\n");
+    numa_tests();
+    printf("PASSED: numa_tests\n");
+    slab_tests();
+    printf("PASSED: slab_tests\n");
+    region_tests();
+    printf("PASSED: region_tests\n");
+    handle_tests();
+    printf("PASSED: handle_tests\n");
+    profile_tests();
+    printf("PASSED: profile_tests\n");
     clock_t end = clock();
     double time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
     printf("\nTime elapsed: %g seconds\n", time_spent);
@@ -0,0 +1,272 @@
+#include "rbt.hpp"
+#include "rbt_pmr.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#define ERROR "\033[31;1mError: \033[0m"
+
+#define TREE_BLOCKS 2000 // number of blocks in the tested intrusive trees
+#define PMR_HEAP_SIZE (8 << 20) // number of bytes in the heap of each tested resource
+#define PMR_ELEMENTS 5000       // number of elements in each tested container
+#define PMR_THREADS 4           // number of threads sharing a synchronized resource
+
+// A block of memory, indexed by its size.
+struct Block : rbt::hook<Block> {
+    unsigned int size;
+    bool in_tree;
+};
+
+using Tree = rbt::intrusive_tree<Block, &Block::size>;
+using ReverseTree = rbt::intrusive_tree<Block, &Block::size, std::greater<>>;
+
+static_assert(!std::is_copy_constructible_v<Tree> && !std::is_copy_assignable_v<Tree>,
+              "intrusive trees must not be copyable");
+static_assert(std::is_nothrow_move_constructible_v<Tree> &&
+              std::is_nothrow_move_assignable_v<Tree>,
+              "intrusive trees must be movable");
+static_assert(std::is_same_v<Tree::key_type, unsigned int>,
+              "the key type is the type of the member");
+
+// Check that the keys visited by for_each are those of `sizes` (in order).
+template <class T>
+void same_keys(const T &tree, const std::multiset<unsigned int> &sizes) {
+    std::vector<unsigned int> keys;
+    tree.for_each([&](Block *block) { keys.push_back(block->size); });
+    if (tree.size() != sizes.size() || keys.size() != sizes.size()) {
+        std::printf(ERROR "tree has %zu nodes (%zu visited) instead of %zu\n",
+                    tree.size(), keys.size(), sizes.size());
+        std::exit(1);
+    }
+    if (!std::equal(keys.begin(), keys.end(), sizes.begin()) &&
+        !std::equal(keys.begin(), keys.end(), sizes.rbegin())) {
+        std::printf(ERROR "for_each visited the keys out of order\n");
+        std::exit(1);
+    }
+}
+
+// Check intrusive trees against a multiset of the sizes in the tree: random
+// insertions, removals of given nodes (heads and duplicates) and removals of
+// the smallest size that is at least a random size.
+void intrusive_tree_tests() {
+    std::vector<Block> blocks(TREE_BLOCKS);
+    std::multiset<unsigned int> sizes;
+    Tree tree;
+    for (int j = 0; j < 20 * TREE_BLOCKS; j++) {
+        Block *block = &blocks[std::rand() % TREE_BLOCKS];
+        if (!block->in_tree) {
+            block->size = std::rand() % (TREE_BLOCKS / 4);
+            tree.insert(block);
+            sizes.insert(block->size);
+            block->in_tree = true;
+        } else if (j % 2 == 0) {
+            if (!tree.remove(block)) {
+                std::printf(ERROR "remove(...) did not find a node in the tree\n");
+                std::exit(1);
+            }
+            sizes.erase(sizes.find(block->size));
+            block->in_tree = false;
+        } else {
+            unsigned int size = std::rand() % (TREE_BLOCKS / 4 + 10);
+            auto expected = sizes.lower_bound(size);
+            Block *bound = tree.lower_bound(size);
+            Block *removed = tree.remove_at_least(size);
+            if (expected == sizes.end()) {
+                if (removed != nullptr || bound != nullptr) {
+                    std::printf(ERROR "remove_at_least(%u) found a node\n", size);
+                    std::exit(1);
+                }
+                continue;
+            }
+            if (removed == nullptr || removed->size != *expected ||
+                bound == nullptr || bound->size != *expected) {
+                std::printf(ERROR "remove_at_least(%u) should find size %u\n",
+                            size, *expected);
+                std::exit(1);
+            }
+            sizes.erase(expected);
+            removed->in_tree = false;
+        }
+        tree.rep_ok();
+        Block *found = tree.find(block->size);
+        if ((found != nullptr) != (sizes.count(block->size) > 0)) {
+            std::printf(ERROR "find(%u) is wrong\n", block->size);
+            std::exit(1);
+        }
+    }
+    same_keys(tree, sizes);
+    if (tree.height() > 2 * (int) std::log2(tree.size() + 1) + 1) {
+        std::printf(ERROR "tree of %zu nodes is too high (%d)\n", tree.size(),
+                    tree.height());
+        std::exit(1);
+    }
+
+    // a node that is not in the tree is not removed
+    Block outside;
+    outside.size = 1;
+    if (tree.remove(&outside)) {
+        std::printf(ERROR "remove(...) removed a node that is not in the tree\n");
+        std::exit(1);
+    }
+
+    // the tree moves with its nodes
+    Tree moved = std::move(tree);
+    if (!tree.empty() || tree.size() != 0) {
+        std::printf(ERROR "a moved-from tree should be empty\n");
+        std::exit(1);
+    }
+    same_keys(moved, sizes);
+    tree = std::move(moved);
+    same_keys(tree, sizes);
+
+    // every node is disposed of
+    std::size_t disposed = 0;
+    tree.clear_and_dispose([&](Block *block) {
+        block->in_tree = false;
+        disposed++;
+    });
+    if (disposed != sizes.size() || !tree.empty()) {
+        std::printf(ERROR "clear_and_dispose visited %zu nodes instead of %zu\n",
+                    disposed, sizes.size());
+        std::exit(1);
+    }
+    sizes.clear();
+
+    // a comparator orders the tree
+    ReverseTree reverse;
+    for (int k = 0; k < TREE_BLOCKS; k++) {
+        blocks[k].size = k % 100;
+        reverse.insert(&blocks[k]);
+        sizes.insert(k % 100);
+    }
+    reverse.rep_ok();
+    same_keys(reverse, sizes);
+    Block *largest = reverse.remove_at_least(1000);
+    if (largest == nullptr || largest->size != 99) {
+        std::printf(ERROR "remove_at_least in a reversed tree should find 99\n");
+        std::exit(1);
+    }
+    while (reverse.remove_at_least(1000) != nullptr) {
+    }
+    if (!reverse.empty()) {
+        std::printf(ERROR "every node should have been removed\n");
+        std::exit(1);
+    }
+}
+
+// Check that the heap of `resource` is consistent and that nothing is
+// allocated from it.
+void heap_empty(rbt::heap_resource &resource) {
+    RBT_heap_ok(resource.heap());
+    RBT_heap_flush(resource.heap());
+    RBT_heap_stats stats;
+    RBT_heap_get_stats(resource.heap(), &stats);
+    if (stats.used_blocks != 0 || stats.free_blocks != 1) {
+        std::printf(ERROR "heap has %zu blocks in use and %zu free blocks\n",
+                    stats.used_blocks, stats.free_blocks);
+        std::exit(1);
+    }
+}
+
+// Fill a map and a vector of strings from `resource`, check their contents,
+// and destroy them.
+void fill_containers(std::pmr::memory_resource *resource, int seed) {
+    std::pmr::unordered_map<int, int> map(resource);
+    std::pmr::vector<std::pmr::string> strings(resource);
+    for (int k = 0; k < PMR_ELEMENTS; k++) {
+        map[k * seed] = k;
+        if (k % 3 == 0) {
+            map.erase((k / 2) * seed);
+        }
+        strings.emplace_back(std::to_string(k) + " is a long string that is not inline");
+    }
+    for (const auto &[key, value] : map) {
+        if (key != value * seed) {
+            std::printf(ERROR "map element %d was overwritten\n", value);
+            std::exit(1);
+        }
+    }
+    for (int k = 0; k < PMR_ELEMENTS; k++) {
+        if (strings[k].compare(0, std::to_string(k).size(), std::to_string(k)) != 0) {
+            std::printf(ERROR "string %d was overwritten\n", k);
+            std::exit(1);
+        }
+    }
+}
+
+// Check the memory_resource adapters: containers allocate from the heap and
+// return every block to it, over-aligned allocations are aligned, exhaustion
+// throws std::bad_alloc, and a synchronized resource is shared by threads.
+void pmr_tests() {
+    std::unique_ptr<char[]> mem(new char[PMR_HEAP_SIZE]);
+    try {
+        rbt::heap_resource tiny(mem.get(), 16);
+        std::printf(ERROR "a resource was initialized over 16 bytes\n");
+        std::exit(1);
+    } catch (const std::invalid_argument &) {
+    }
+
+    rbt::heap_resource resource(mem.get(), PMR_HEAP_SIZE);
+    fill_containers(&resource, 7);
+    heap_empty(resource);
+
+    void *aligned = resource.allocate(1000, 4096);
+    if ((std::size_t) aligned % 4096 != 0) {
+        std::printf(ERROR "allocate(1000, 4096) is not aligned\n");
+        std::exit(1);
+    }
+    resource.deallocate(aligned, 1000, 4096);
+    try {
+        (void) resource.allocate(2 * PMR_HEAP_SIZE);
+        std::printf(ERROR "allocate(...) should throw once the heap is full\n");
+        std::exit(1);
+    } catch (const std::bad_alloc &) {
+    }
+    heap_empty(resource);
+
+    rbt::heap_resource same(resource.heap());
+    RBT_heap other_heap;
+    rbt::heap_resource other(&other_heap);
+    if (!resource.is_equal(same) || resource.is_equal(other) ||
+        resource.is_equal(*std::pmr::new_delete_resource())) {
+        std::printf(ERROR "resources are equal only if they share a heap\n");
+        std::exit(1);
+    }
+
+    rbt::synchronized_heap_resource shared(mem.get(), PMR_HEAP_SIZE);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < PMR_THREADS; t++) {
+        threads.emplace_back(fill_containers, &shared, t + 1);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    heap_empty(shared);
+}
+
+int main() {
+    std::clock_t begin = std::clock();
+    std::srand(std::time(0));
+    intrusive_tree_tests();
+    std::printf("PASSED: intrusive_tree_tests\n");
+    pmr_tests();
+    std::printf("PASSED: pmr_tests\n");
+    std::clock_t end = std::clock();
+    double time_spent = (double) (end - begin) / CLOCKS_PER_SEC;
+    std::printf("\nTime elapsed: %g seconds\n", time_spent);
+
+    return 0;
+}
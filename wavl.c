@@ -0,0 +1,475 @@
+//////////////////////////////////////////////////////////////////////////////
+// wavl.c                                                                   //
+//////////////////////////////////////////////////////////////////////////////
+// wavl.c contains implementations of the functions declared in wavl.h.
+//
+// The rebalancing rules follow Haeupler, Sen and Tarjan, "Rank-Balanced
+// Trees" (ACM Transactions on Algorithms, 2015). Promoting or demoting a node
+// (increasing or decreasing its rank by 1) flips its parity.
+#include "wavl.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#define WAVL_ERROR "\033[31;1mError: \033[0m"
+
+#ifdef ALLOC_TRACK
+extern unsigned int NUM_NODES; // (see rbt.c)
+#endif // ALLOC_TRACK
+
+// helper: Returns the parity of the rank of `node` (missing nodes have rank
+// -1, which is odd).
+unsigned int WAVL_parity(RBT node) {
+    if (node == NULL) {
+        return 1;
+    }
+    return node->color & 1;
+}
+
+// helper: Returns the rank difference (1 or 2) between `parent` and its child
+// `child`. Only valid while the difference is actually 1 or 2.
+int WAVL_diff(RBT parent, RBT child) {
+    return WAVL_parity(parent) != WAVL_parity(child) ? 1 : 2;
+}
+
+// helper: Promotes or demotes `node` by 1.
+void WAVL_flip(RBT node) {
+    node->color ^= 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// WAVL Insertion                                                           //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Rebalances `root` after the rank of its left child increased,
+// making it a 0-child. Sets `grew` if the rank of `root` increased.
+// Returns the new root.
+RBT WAVL_insert_fix_left(RBT root, bool *grew) {
+    RBT left = root->left;
+    if (WAVL_diff(root, root->right) == 1) { // promote and propagate upward
+        WAVL_flip(root);
+        *grew = true;
+        return root;
+    }
+    *grew = false;
+    RBT inner = left->right;
+    if (WAVL_diff(left, inner) == 2) { // rotate right & demote root
+        root->left = inner;
+        left->right = root;
+        WAVL_flip(root);
+        return left; // left is the new root
+    }
+    // double rotate, promote inner & demote left and root
+    left->right = inner->left;
+    root->left = inner->right;
+    inner->left = left;
+    inner->right = root;
+    WAVL_flip(inner);
+    WAVL_flip(left);
+    WAVL_flip(root);
+    return inner; // inner is the new root
+}
+
+// helper: Mirror image of WAVL_insert_fix_left.
+RBT WAVL_insert_fix_right(RBT root, bool *grew) {
+    RBT right = root->right;
+    if (WAVL_diff(root, root->left) == 1) { // promote and propagate upward
+        WAVL_flip(root);
+        *grew = true;
+        return root;
+    }
+    *grew = false;
+    RBT inner = right->left;
+    if (WAVL_diff(right, inner) == 2) { // rotate left & demote root
+        root->right = inner;
+        right->left = root;
+        WAVL_flip(root);
+        return right; // right is the new root
+    }
+    // double rotate, promote inner & demote right and root
+    right->left = inner->right;
+    root->right = inner->left;
+    inner->right = right;
+    inner->left = root;
+    WAVL_flip(inner);
+    WAVL_flip(right);
+    WAVL_flip(root);
+    return inner; // inner is the new root
+}
+
+// helper: recursive part of WAVL_add. Sets `grew` if the rank of `root`
+// increased.
+RBT WAVL_add_inner(RBT root, RBT node, unsigned int capacity, bool *grew) {
+    if (root == NULL) {
+        node->capacity = capacity;
+        node->prev_dist = 0;
+        node->left = NULL;
+        node->right = NULL;
+        node->next = NULL;
+        node->in_use = false;
+        node->color = 0; // new nodes are leaves (rank 0)
+        *grew = true;
+        return node;
+    }
+
+    unsigned int c = root->capacity;
+    if (capacity == c) { // add the new node to the linked-list
+        RBT_link_duplicate(root, WAVL_add_inner(NULL, node, capacity, grew));
+        *grew = false;
+        return root;
+    } else if (capacity < c) {
+        int diff = WAVL_diff(root, root->left);
+        root->left = WAVL_add_inner(root->left, node, capacity, grew);
+        if (!*grew || diff == 2) { // root->left is (at worst) a 1-child
+            *grew = false;
+            return root;
+        }
+        return WAVL_insert_fix_left(root, grew);
+    }
+    int diff = WAVL_diff(root, root->right);
+    root->right = WAVL_add_inner(root->right, node, capacity, grew);
+    if (!*grew || diff == 2) { // root->right is (at worst) a 1-child
+        *grew = false;
+        return root;
+    }
+    return WAVL_insert_fix_right(root, grew);
+}
+
+RBT WAVL_add(RBT root, RBT node, unsigned int capacity) {
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    if (node == NULL) {
+        return root;
+    }
+    bool grew;
+    root = WAVL_add_inner(root, node, capacity, &grew);
+    #ifdef ALLOC_TRACK
+    NUM_NODES++;
+    #endif // ALLOC_TRACK
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    return root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// WAVL Removal                                                             //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Rebalances `root` after the rank of its left subtree decreased by 1.
+// `diff` is the rank difference of the left child before the decrease. Sets
+// `shrank` if the rank of `root` decreased. Returns the new root.
+RBT WAVL_delete_fix_left(RBT root, int diff, bool *shrank) {
+    RBT right = root->right;
+    if (diff == 1) { // root->left is now a 2-child
+        if (root->left == NULL && right == NULL) { // demote a 2,2 leaf
+            WAVL_flip(root);
+            *shrank = true;
+            return root;
+        }
+        *shrank = false;
+        return root;
+    }
+    // { root->left is a 3-child }
+    if (WAVL_diff(root, right) == 2) { // demote and propagate upward
+        WAVL_flip(root);
+        *shrank = true;
+        return root;
+    }
+    // { root->right is a 1-child (and not NULL) }
+    RBT inner = right->left;
+    RBT outer = right->right;
+    int outer_diff = WAVL_diff(right, outer);
+    if (outer_diff == 2 && WAVL_diff(right, inner) == 2) {
+        // demote root and right and propagate upward
+        WAVL_flip(root);
+        WAVL_flip(right);
+        *shrank = true;
+        return root;
+    }
+    *shrank = false;
+    if (outer_diff == 1) { // rotate left, promote right & demote root
+        root->right = inner;
+        right->left = root;
+        WAVL_flip(right);
+        WAVL_flip(root);
+        if (root->left == NULL && root->right == NULL) { // demote a 2,2 leaf
+            WAVL_flip(root);
+        }
+        return right; // right is the new root
+    }
+    // double rotate, promote inner twice, demote right & demote root twice
+    root->right = inner->left;
+    right->left = inner->right;
+    inner->left = root;
+    inner->right = right;
+    WAVL_flip(right);
+    return inner; // inner is the new root
+}
+
+// helper: Mirror image of WAVL_delete_fix_left.
+RBT WAVL_delete_fix_right(RBT root, int diff, bool *shrank) {
+    RBT left = root->left;
+    if (diff == 1) { // root->right is now a 2-child
+        if (root->right == NULL && left == NULL) { // demote a 2,2 leaf
+            WAVL_flip(root);
+            *shrank = true;
+            return root;
+        }
+        *shrank = false;
+        return root;
+    }
+    // { root->right is a 3-child }
+    if (WAVL_diff(root, left) == 2) { // demote and propagate upward
+        WAVL_flip(root);
+        *shrank = true;
+        return root;
+    }
+    // { root->left is a 1-child (and not NULL) }
+    RBT inner = left->right;
+    RBT outer = left->left;
+    int outer_diff = WAVL_diff(left, outer);
+    if (outer_diff == 2 && WAVL_diff(left, inner) == 2) {
+        // demote root and left and propagate upward
+        WAVL_flip(root);
+        WAVL_flip(left);
+        *shrank = true;
+        return root;
+    }
+    *shrank = false;
+    if (outer_diff == 1) { // rotate right, promote left & demote root
+        root->left = inner;
+        left->right = root;
+        WAVL_flip(left);
+        WAVL_flip(root);
+        if (root->left == NULL && root->right == NULL) { // demote a 2,2 leaf
+            WAVL_flip(root);
+        }
+        return left; // left is the new root
+    }
+    // double rotate, promote inner twice, demote left & demote root twice
+    root->left = inner->right;
+    left->right = inner->left;
+    inner->right = root;
+    inner->left = left;
+    WAVL_flip(left);
+    return inner; // inner is the new root
+}
+
+// helper: Detaches the node with the smallest capacity from `root` and stores
+// it in `min`. Sets `shrank` if the rank of `root` decreased. Returns the new
+// root.
+// Assumes root is not NULL.
+RBT WAVL_remove_min(RBT root, RBT *min, bool *shrank) {
+    if (root->left == NULL) {
+        RBT right = root->right;
+        root->right = NULL;
+        *min = root;
+        *shrank = true; // root had at most one child, so it is replaced by it
+        return right;
+    }
+    int diff = WAVL_diff(root, root->left);
+    root->left = WAVL_remove_min(root->left, min, shrank);
+    if (!*shrank) {
+        return root;
+    }
+    return WAVL_delete_fix_left(root, diff, shrank);
+}
+
+// helper: Detaches the tree node `root` (whose linked list has been dealt
+// with). Sets `shrank` if the rank of the subtree decreased. Returns the new
+// root.
+//
+// NOTE: a node with at most one child has rank 0 or 1, and its child (if any)
+// is a leaf, so replacing the node by its child always decreases the rank by
+// exactly 1.
+RBT WAVL_remove_tree_node(RBT root, bool *shrank) {
+    RBT left = root->left;
+    RBT right = root->right;
+    root->left = NULL;
+    root->right = NULL;
+    if (left == NULL || right == NULL) {
+        *shrank = true;
+        return left != NULL ? left : right;
+    }
+    // replace root with its successor (which takes root's rank)
+    int diff = WAVL_diff(root, right);
+    RBT successor;
+    right = WAVL_remove_min(right, &successor, shrank);
+    successor->left = left;
+    successor->right = right;
+    successor->color = root->color;
+    if (!*shrank) {
+        return successor;
+    }
+    return WAVL_delete_fix_right(successor, diff, shrank);
+}
+
+// helper: Removes the root node (or a node from its linked-list, if there is
+// one) and stores it in `removed`. Sets `shrank` if the rank of the subtree
+// decreased. Returns the new root.
+// Assumes: root is not NULL.
+RBT WAVL_remove_root(RBT root, RBT *removed, bool *shrank) {
+    RBT target = RBT_remove_duplicate(root);
+    if (target != NULL) { // a node was removed from root's linked list
+        *removed = target;
+        *shrank = false;
+        return root;
+    }
+    *removed = root;
+    return WAVL_remove_tree_node(root, shrank);
+}
+
+// helper: recursive part of WAVL_remove_at_least.
+RBT WAVL_remove_at_least_inner(RBT root, unsigned int capacity, RBT *removed,
+        bool *shrank) {
+    if (root == NULL) {
+        *removed = NULL;
+        *shrank = false;
+        return NULL;
+    }
+
+    unsigned int c = root->capacity;
+    if (capacity == c) { // root has the target capacity
+        return WAVL_remove_root(root, removed, shrank);
+    } else if (capacity < c) { // root->left may have a better fitting node
+        int diff = WAVL_diff(root, root->left);
+        RBT new_left = WAVL_remove_at_least_inner(root->left, capacity, removed, shrank);
+        if (*removed == NULL) { // no nodes are a better fit than root
+            return WAVL_remove_root(root, removed, shrank);
+        }
+        root->left = new_left;
+        if (!*shrank) {
+            return root;
+        }
+        return WAVL_delete_fix_left(root, diff, shrank);
+    }
+    // root is too small to fit `capacity`
+    int diff = WAVL_diff(root, root->right);
+    RBT new_right = WAVL_remove_at_least_inner(root->right, capacity, removed, shrank);
+    if (*removed == NULL) { // no nodes in root->right are large enough
+        return root;
+    }
+    root->right = new_right;
+    if (!*shrank) {
+        return root;
+    }
+    return WAVL_delete_fix_right(root, diff, shrank);
+}
+
+RBT WAVL_remove_at_least(RBT root, unsigned int capacity, RBT *removed) {
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    if (removed == NULL) {
+        return root;
+    }
+    bool shrank;
+    root = WAVL_remove_at_least_inner(root, capacity, removed, &shrank);
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    return root;
+}
+
+// helper: Removes `node` from `root` or its linked list (see
+// RBT_remove_node_root).
+// Assumes: root is not NULL and root->capacity == node->capacity.
+RBT WAVL_remove_node_root(RBT root, RBT node, RBT *removed, bool *shrank) {
+    *shrank = false;
+    if (node != root) { // `node` can only be in `root`'s linked list
+        *removed = RBT_unlink_duplicate(root, node) ? node : NULL;
+        return root;
+    }
+    // { node == root }
+    if (root->next != NULL) { // replace `root` with the next node in its list
+        *removed = root;
+        return RBT_replace_head(root);
+    }
+    *removed = root;
+    return WAVL_remove_tree_node(root, shrank);
+}
+
+// helper: recursive part of WAVL_remove_node.
+RBT WAVL_remove_node_inner(RBT root, RBT node, unsigned int capacity,
+        RBT *removed, bool *shrank) {
+    if (root == NULL) {
+        *removed = NULL;
+        *shrank = false;
+        return NULL;
+    }
+
+    unsigned int c = root->capacity;
+    if (capacity == c) {
+        return WAVL_remove_node_root(root, node, removed, shrank);
+    } else if (capacity < c) {
+        int diff = WAVL_diff(root, root->left);
+        root->left = WAVL_remove_node_inner(root->left, node, capacity, removed, shrank);
+        if (!*shrank) {
+            return root;
+        }
+        return WAVL_delete_fix_left(root, diff, shrank);
+    }
+    int diff = WAVL_diff(root, root->right);
+    root->right = WAVL_remove_node_inner(root->right, node, capacity, removed, shrank);
+    if (!*shrank) {
+        return root;
+    }
+    return WAVL_delete_fix_right(root, diff, shrank);
+}
+
+RBT WAVL_remove_node(RBT root, RBT node, RBT *removed) {
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    if (removed == NULL) {
+        return root;
+    }
+    if (node == NULL) {
+        *removed = NULL;
+        return root;
+    }
+    bool shrank;
+    root = WAVL_remove_node_inner(root, node, node->capacity, removed, &shrank);
+    #ifdef REP_OK
+    WAVL_rep_ok(root);
+    #endif
+    return root;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// WAVL rep_ok                                                              //
+//////////////////////////////////////////////////////////////////////////////
+// helper: Returns the rank of `root`, raising SIGABRT if the ranks implied by
+// the parities of `root`'s subtrees are inconsistent.
+int WAVL_rank_ok(RBT root) {
+    if (root == NULL) {
+        return -1;
+    }
+    int left_rank = WAVL_rank_ok(root->left) + WAVL_diff(root, root->left);
+    int right_rank = WAVL_rank_ok(root->right) + WAVL_diff(root, root->right);
+    if (left_rank != right_rank) {
+        printf(WAVL_ERROR "node %u has rank %d by its left child and %d by its right\n",
+                root->capacity, left_rank, right_rank);
+        raise(SIGABRT);
+    }
+    if (root->left == NULL && root->right == NULL && left_rank != 0) {
+        printf(WAVL_ERROR "leaf %u should have rank 0 (not %d)\n",
+                root->capacity, left_rank);
+        raise(SIGABRT);
+    }
+    // (only the first two nodes of the linked list are checked)
+    RBT first = root->next;
+    if (first != NULL && (first->left == NULL ||
+            (first->next != NULL) != (RBT_count(root) > 2))) {
+        printf(WAVL_ERROR "node %u has count %zu\n", root->capacity, RBT_count(root));
+        raise(SIGABRT);
+    }
+    return left_rank;
+}
+
+RBT WAVL_rep_ok(RBT root) {
+    WAVL_rank_ok(root);
+    return root;
+}
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// wavl.h                                                                   //
+//////////////////////////////////////////////////////////////////////////////
+// wavl.h contains declarations of functions for weak AVL (WAVL) trees, an
+// alternative to RBTs with the same node type and the same semantics as
+// RBT_add, RBT_remove_at_least and RBT_remove_node.
+//
+// A WAVL tree gives every node a rank: missing children (NULL) have rank -1,
+// leaves have rank 0, and the rank of every child is 1 or 2 less than the rank
+// of its parent. Only the parity of each rank is stored (in the `color` field
+// of the node), which suffices to tell the rank differences of 1 and 2 apart.
+//
+// Rebalancing after an insertion or a removal does at most two rotations (and
+// O(1) amortized rank changes), and a tree built by insertions alone is an AVL
+// tree, with height at most 1.44 * log2(n) (vs. 2 * log2(n) for an RBT).
+//
+// WAVL trees are `RBT`s as far as traversal is concerned: RBT_cursor_*,
+// RBT_height, RBT_free, etc. can be applied to them. Functions which depend on
+// node colors (e.g. RBT_black_height) cannot.
+//
+// Conditional Compilation:
+// The ALLOC_TRACK and REP_OK flags (see rbt.h) apply to WAVL trees as well.
+
+#ifndef WAVL_H
+#define WAVL_H
+
+#include "rbt.h"
+
+// WAVL_add inserts a new node into the WAVL tree `root` with the same semantics
+// as RBT_add (see rbt.h).
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = WAVL_add(tree, ...);
+RBT WAVL_add(RBT root, RBT node, unsigned int capacity);
+
+// WAVL_remove_at_least removes the smallest node whose capacity is at least
+// that requested, with the same semantics as RBT_remove_at_least.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = WAVL_remove_at_least(tree, ..., ...);
+RBT WAVL_remove_at_least(RBT root, unsigned int capacity, RBT *removed);
+
+// WAVL_remove_node removes the given node, with the same semantics as
+// RBT_remove_node.
+//
+// NOTE: to avoid memory leaks ALWAYS assign the result to the provided root.
+//   e.g. tree = WAVL_remove_node(tree, ..., ...);
+RBT WAVL_remove_node(RBT root, RBT node, RBT *removed);
+
+// WAVL_rep_ok checks the representation invariant for WAVL trees:
+//   + The rank difference of every child is 1 or 2.
+//   + Every leaf has rank 0.
+// If the invariant is violated, raises SIGABRT. Otherwise, returns the
+// original tree (unchanged).
+RBT WAVL_rep_ok(RBT root);
+
+#endif /* WAVL_H */